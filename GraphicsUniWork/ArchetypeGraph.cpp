@@ -0,0 +1,376 @@
+#include "ArchetypeGraph.h"
+#include "MemTrack.h"
+#include "Query.h"
+#include "StringPool.h"
+#include <stdio.h>
+
+#define NO_FIELD 0xFFu
+
+bool archetypeGraphCreate(ArchetypeGraph* graph, EntityRegistry* registry, u32 arenaCapacity)
+{
+    memset(graph, 0, sizeof(ArchetypeGraph));
+    graph->registry = registry;
+    graph->arenaCapacity = arenaCapacity;
+    if (!createFlatMap(&graph->byMask, 64, sizeof(ComponentMask), sizeof(u32), FLAT_MAP_DEFAULT))
+    {
+        ERROR("Failed to create archetype graph");
+        return false;
+    }
+    return true;
+}
+
+// druid allocates the arenas, so their size is recorded with the tracker by hand
+static u64 archetypeBytes(const Archetype* arch)
+{
+    const u64 entitySize = getEntitySize(arch->layout);
+    u64 bytes = sizeof(EntityArena) * (u64)arch->arenaCount;
+    for (u32 a = 0; a < arch->arenaCount; a++)
+        bytes += entitySize * arch->arena[a].entityCount + sizeof(void*) * (u64)arch->layout->count;
+    return bytes;
+}
+
+void archetypeGraphDestroy(ArchetypeGraph* graph)
+{
+    for (u32 i = 0; i < graph->nodeCount; i++)
+    {
+        ArchetypeNode* node = graph->nodes[i];
+        if (node->owned)
+        {
+            MEM_RELEASE(MEM_TAG_ECS, archetypeBytes(node->arch));
+            destroyArchetype(node->arch);
+            MEM_FREE(node->arch);
+            MEM_FREE(node->layout.fields);
+        }
+        MEM_FREE(node);
+    }
+    MEM_FREE(graph->nodes);
+    MEM_FREE(graph->nodeOfArchetype);
+    MEM_FREE(graph->queries);
+    destroyFlatMap(&graph->byMask);
+    memset(graph, 0, sizeof(ArchetypeGraph));
+}
+
+ComponentId componentFind(const ArchetypeGraph* graph, const char* name)
+{
+    for (u32 i = 0; i < graph->componentCount; i++)
+    {
+        if (strcmp(graph->components[i].name, name) == 0)
+            return i;
+    }
+    return ARCHETYPE_NO_NODE;
+}
+
+ComponentId componentRegister(ArchetypeGraph* graph, const char* name, u32 size)
+{
+    const ComponentId existing = componentFind(graph, name);
+    if (existing != ARCHETYPE_NO_NODE)
+    {
+        if (graph->components[existing].size != size)
+        {
+            ERROR("Component %s registered as %u bytes, now %u", name, graph->components[existing].size, size);
+            return ARCHETYPE_NO_NODE;
+        }
+        return existing;
+    }
+    if (graph->componentCount == ECS_MAX_COMPONENTS)
+    {
+        ERROR("Out of component ids registering %s", name);
+        return ARCHETYPE_NO_NODE;
+    }
+
+    FieldInfo* info = &graph->components[graph->componentCount];
+    info->name = internedString(intern(name));
+    info->size = size;
+    return graph->componentCount++;
+}
+
+static bool mapArchetype(ArchetypeGraph* graph, u32 archetypeId, u32 node)
+{
+    if (archetypeId >= graph->nodeOfCapacity)
+    {
+        u32 capacity = graph->nodeOfCapacity ? graph->nodeOfCapacity : 64;
+        while (capacity <= archetypeId) capacity *= 2;
+        u32* grown = (u32*)MEM_ALLOC(sizeof(u32) * capacity, MEM_TAG_ECS);
+        if (!grown)
+        {
+            ERROR("Failed to grow archetype lookup");
+            return false;
+        }
+        memset(grown, 0xFF, sizeof(u32) * capacity);
+        if (graph->nodeOfArchetype)
+        {
+            memcpy(grown, graph->nodeOfArchetype, sizeof(u32) * graph->nodeOfCapacity);
+            MEM_FREE(graph->nodeOfArchetype);
+        }
+        graph->nodeOfArchetype = grown;
+        graph->nodeOfCapacity = capacity;
+    }
+    graph->nodeOfArchetype[archetypeId] = node;
+    return true;
+}
+
+// takes over a node whose mask, arch and field tables are filled in
+static u32 addNode(ArchetypeGraph* graph, ArchetypeNode* node)
+{
+    if (graph->nodeCount == graph->nodeCapacity)
+    {
+        const u32 capacity = graph->nodeCapacity ? graph->nodeCapacity * 2 : 16;
+        ArchetypeNode** grown = (ArchetypeNode**)MEM_ALLOC(sizeof(ArchetypeNode*) * capacity, MEM_TAG_ECS);
+        if (!grown)
+        {
+            ERROR("Failed to grow archetype graph");
+            return ARCHETYPE_NO_NODE;
+        }
+        if (graph->nodes)
+        {
+            memcpy(grown, graph->nodes, sizeof(ArchetypeNode*) * graph->nodeCount);
+            MEM_FREE(graph->nodes);
+        }
+        graph->nodes = grown;
+        graph->nodeCapacity = capacity;
+    }
+
+    // the registry goes last: a failure before it leaves nothing that points
+    // at an archetype the caller is about to destroy
+    const u32 index = graph->nodeCount;
+    const u32 id = node->arch->id;
+    const u32 previous = id < graph->nodeOfCapacity ? graph->nodeOfArchetype[id] : ARCHETYPE_NO_NODE;
+    if (!mapArchetype(graph, id, index))
+        return ARCHETYPE_NO_NODE;
+    if (!flatMapInsert(&graph->byMask, &node->mask, &index))
+    {
+        graph->nodeOfArchetype[id] = previous;
+        return ARCHETYPE_NO_NODE;
+    }
+    if (!entityRegistryTable(graph->registry, id) && !entityRegistryAdd(graph->registry, node->arch))
+    {
+        flatMapErase(&graph->byMask, &node->mask);
+        graph->nodeOfArchetype[id] = previous;
+        return ARCHETYPE_NO_NODE;
+    }
+
+    graph->nodes[graph->nodeCount++] = node;
+    for (u32 q = 0; q < graph->queryCount; q++)
+        queryMatchNode(graph->queries[q], index);
+    return index;
+}
+
+static ArchetypeNode* allocNode(ComponentMask mask)
+{
+    ArchetypeNode* node = (ArchetypeNode*)MEM_CALLOC(sizeof(ArchetypeNode), MEM_TAG_ECS);
+    if (!node)
+    {
+        ERROR("Failed to allocate archetype node");
+        return NULL;
+    }
+    node->mask = mask;
+    memset(node->fieldOfComponent, NO_FIELD, sizeof(node->fieldOfComponent));
+    memset(node->componentOfField, NO_FIELD, sizeof(node->componentOfField));
+    memset(node->addEdge, 0xFF, sizeof(node->addEdge));
+    memset(node->removeEdge, 0xFF, sizeof(node->removeEdge));
+    return node;
+}
+
+u32 archetypeGraphAdopt(ArchetypeGraph* graph, Archetype* arch)
+{
+    const StructLayout* layout = arch->layout;
+    if (layout->count > ECS_MAX_COMPONENTS)
+    {
+        ERROR("Layout %s has more fields than the graph has component ids", layout->name);
+        return ARCHETYPE_NO_NODE;
+    }
+
+    ComponentId ids[ECS_MAX_COMPONENTS];
+    ComponentMask mask = 0;
+    for (u32 f = 0; f < layout->count; f++)
+    {
+        ids[f] = componentRegister(graph, layout->fields[f].name, layout->fields[f].size);
+        if (ids[f] == ARCHETYPE_NO_NODE) return ARCHETYPE_NO_NODE;
+        mask |= componentBit(ids[f]);
+    }
+
+    const u32* existing = (const u32*)flatMapFind(&graph->byMask, &mask);
+    if (existing)
+    {
+        if (graph->nodes[*existing]->arch != arch)
+            ERROR("Layout %s has the same components as %s", layout->name, graph->nodes[*existing]->arch->layout->name);
+        return *existing;
+    }
+
+    ArchetypeNode* node = allocNode(mask);
+    if (!node) return ARCHETYPE_NO_NODE;
+    node->arch = arch;
+    for (u32 f = 0; f < layout->count; f++)
+    {
+        node->fieldOfComponent[ids[f]] = (u8)f;
+        node->componentOfField[f] = (u8)ids[f];
+    }
+
+    const u32 index = addNode(graph, node);
+    if (index == ARCHETYPE_NO_NODE) MEM_FREE(node);
+    return index;
+}
+
+u32 archetypeGraphFind(ArchetypeGraph* graph, ComponentMask mask)
+{
+    const u32* existing = (const u32*)flatMapFind(&graph->byMask, &mask);
+    if (existing) return *existing;
+
+    if (mask == 0 || (graph->componentCount < ECS_MAX_COMPONENTS && (mask >> graph->componentCount) != 0))
+    {
+        ERROR("Invalid component mask 0x%llx", (unsigned long long)mask);
+        return ARCHETYPE_NO_NODE;
+    }
+
+    ArchetypeNode* node = allocNode(mask);
+    if (!node) return ARCHETYPE_NO_NODE;
+
+    // fields in component order so equal masks always give equal layouts
+    u32 fieldCount = 0;
+    FieldInfo fields[ECS_MAX_COMPONENTS];
+    for (ComponentMask bits = mask; bits; bits &= bits - 1)
+    {
+        ComponentId c = 0;
+        while (!((bits >> c) & 1)) c++;
+        node->fieldOfComponent[c] = (u8)fieldCount;
+        node->componentOfField[fieldCount] = (u8)c;
+        fields[fieldCount++] = graph->components[c];
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "archetype_%llx", (unsigned long long)mask);
+    node->owned = true;
+    node->layout.name = internedString(intern(name));
+    node->layout.count = fieldCount;
+    node->layout.fields = (FieldInfo*)MEM_ALLOC(sizeof(FieldInfo) * fieldCount, MEM_TAG_ECS);
+    node->arch = (Archetype*)MEM_CALLOC(sizeof(Archetype), MEM_TAG_ECS);
+    if (!node->layout.fields || !node->arch)
+    {
+        ERROR("Failed to allocate archetype %s", name);
+        MEM_FREE(node->layout.fields);
+        MEM_FREE(node->arch);
+        MEM_FREE(node);
+        return ARCHETYPE_NO_NODE;
+    }
+    memcpy(node->layout.fields, fields, sizeof(FieldInfo) * fieldCount);
+
+    if (!createArchetype(&node->layout, graph->arenaCapacity, node->arch))
+    {
+        ERROR("Failed to create archetype %s", name);
+        MEM_FREE(node->layout.fields);
+        MEM_FREE(node->arch);
+        MEM_FREE(node);
+        return ARCHETYPE_NO_NODE;
+    }
+    if (entityRegistryTable(graph->registry, node->arch->id))
+    {
+        ERROR("Archetype id %u of %s is already in use", node->arch->id, name);
+        destroyArchetype(node->arch);
+        MEM_FREE(node->layout.fields);
+        MEM_FREE(node->arch);
+        MEM_FREE(node);
+        return ARCHETYPE_NO_NODE;
+    }
+
+    const u32 index = addNode(graph, node);
+    if (index == ARCHETYPE_NO_NODE)
+    {
+        destroyArchetype(node->arch);
+        MEM_FREE(node->layout.fields);
+        MEM_FREE(node->arch);
+        MEM_FREE(node);
+        return ARCHETYPE_NO_NODE;
+    }
+    MEM_RECORD(MEM_TAG_ECS, archetypeBytes(node->arch));
+    return index;
+}
+
+u32 archetypeGraphWith(ArchetypeGraph* graph, u32 node, ComponentId component)
+{
+    assert(component < ECS_MAX_COMPONENTS);
+    ArchetypeNode* from = graph->nodes[node];
+    if (from->mask & componentBit(component)) return node;
+    if (from->addEdge[component] != ARCHETYPE_NO_NODE) return from->addEdge[component];
+
+    const u32 to = archetypeGraphFind(graph, from->mask | componentBit(component));
+    if (to == ARCHETYPE_NO_NODE) return to;
+
+    // both directions at once, the way back is usually taken later
+    from->addEdge[component] = to;
+    graph->nodes[to]->removeEdge[component] = node;
+    return to;
+}
+
+u32 archetypeGraphWithout(ArchetypeGraph* graph, u32 node, ComponentId component)
+{
+    assert(component < ECS_MAX_COMPONENTS);
+    ArchetypeNode* from = graph->nodes[node];
+    if (!(from->mask & componentBit(component))) return node;
+    if (from->removeEdge[component] != ARCHETYPE_NO_NODE) return from->removeEdge[component];
+
+    const u32 to = archetypeGraphFind(graph, from->mask & ~componentBit(component));
+    if (to == ARCHETYPE_NO_NODE) return to;
+
+    from->removeEdge[component] = to;
+    graph->nodes[to]->addEdge[component] = node;
+    return to;
+}
+
+u32 archetypeGraphNodeOf(const ArchetypeGraph* graph, EntityHandle entity)
+{
+    const u32 archetype = entityHandleArchetype(entity);
+    return archetype < graph->nodeOfCapacity ? graph->nodeOfArchetype[archetype] : ARCHETYPE_NO_NODE;
+}
+
+u32 archetypeGraphMigrate(ArchetypeGraph* graph, const EntityHandle* entities, u32 count,
+                          u32 dstNode, EntityHandle* outHandles)
+{
+    if (count == 0) return 0;
+    const u32 srcNode = archetypeGraphNodeOf(graph, entities[0]);
+    if (srcNode == ARCHETYPE_NO_NODE || dstNode >= graph->nodeCount)
+    {
+        ERROR("Migration between archetypes the graph doesn't know");
+        return 0;
+    }
+
+    // shared components map straight across through the component ids
+    const ArchetypeNode* src = graph->nodes[srcNode];
+    const ArchetypeNode* dst = graph->nodes[dstNode];
+    u32 fieldMap[ECS_MAX_COMPONENTS];
+    for (u32 df = 0; df < dst->arch->layout->count; df++)
+    {
+        const u8 sf = src->fieldOfComponent[dst->componentOfField[df]];
+        fieldMap[df] = sf == NO_FIELD ? ENTITY_NO_FIELD : sf;
+    }
+    return entityMigrateBatch(graph->registry, entities, count, dst->arch->id, fieldMap, outHandles);
+}
+
+static EntityHandle migrateOne(ArchetypeGraph* graph, EntityHandle entity, u32 srcNode, u32 dstNode)
+{
+    if (dstNode == ARCHETYPE_NO_NODE) return NULL_ENTITY;
+    if (dstNode == srcNode) return entity;
+
+    EntityHandle moved = NULL_ENTITY;
+    archetypeGraphMigrate(graph, &entity, 1, dstNode, &moved);
+    return moved;
+}
+
+EntityHandle entityAddComponent(ArchetypeGraph* graph, EntityHandle entity, ComponentId component)
+{
+    const u32 node = archetypeGraphNodeOf(graph, entity);
+    if (node == ARCHETYPE_NO_NODE || !entityValid(graph->registry, entity)) return NULL_ENTITY;
+    return migrateOne(graph, entity, node, archetypeGraphWith(graph, node, component));
+}
+
+EntityHandle entityRemoveComponent(ArchetypeGraph* graph, EntityHandle entity, ComponentId component)
+{
+    const u32 node = archetypeGraphNodeOf(graph, entity);
+    if (node == ARCHETYPE_NO_NODE || !entityValid(graph->registry, entity)) return NULL_ENTITY;
+    return migrateOne(graph, entity, node, archetypeGraphWithout(graph, node, component));
+}
+
+bool entityHasComponent(const ArchetypeGraph* graph, EntityHandle entity, ComponentId component)
+{
+    const u32 node = archetypeGraphNodeOf(graph, entity);
+    return node != ARCHETYPE_NO_NODE && (graph->nodes[node]->mask & componentBit(component)) != 0;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <druid.h>
+#include "EntityHandle.h"
+#include "FlatMap.h"
+
+
+// Archetype graph for adding and removing components at runtime.
+// A component is a named field registered once per graph, and an archetype
+// is identified by the bitmask of its components. Each node caches an edge
+// per component to the archetype with that component added or removed. After
+// the first transition, moving an entity costs one array read to find the
+// target plus the migration itself. Missing archetypes are created on demand
+// with their fields in component order. Existing DEFINE_ARCHETYPE archetypes
+// can be adopted, and their field names become components.
+//
+// Migration goes through entityMigrateBatch, which copies the fields both
+// archetypes share one column at a time. Entities get new handles when they
+// change archetype.
+#define ECS_MAX_COMPONENTS 64
+#define ARCHETYPE_NO_NODE 0xFFFFFFFFu
+
+typedef u32 ComponentId;
+typedef u64 ComponentMask;
+
+static inline ComponentMask componentBit(ComponentId component)
+{
+    return 1ull << component;
+}
+
+typedef struct ArchetypeNode {
+    ComponentMask mask;
+    Archetype* arch;
+    bool owned;                               // created by the graph
+    StructLayout layout;                      // backing storage when owned
+    u8 fieldOfComponent[ECS_MAX_COMPONENTS];  // layout field index, 0xFF when absent
+    u8 componentOfField[ECS_MAX_COMPONENTS];
+    u32 addEdge[ECS_MAX_COMPONENTS];          // node index, ARCHETYPE_NO_NODE until first used
+    u32 removeEdge[ECS_MAX_COMPONENTS];
+} ArchetypeNode;
+
+typedef struct ArchetypeGraph {
+    EntityRegistry* registry;
+    FieldInfo components[ECS_MAX_COMPONENTS]; // names are interned
+    u32 componentCount;
+    ArchetypeNode** nodes;
+    u32 nodeCount;
+    u32 nodeCapacity;
+    FlatMap byMask;         // ComponentMask -> node index
+    u32* nodeOfArchetype;   // archetype id -> node index
+    u32 nodeOfCapacity;
+    u32 arenaCapacity;      // entities per archetype the graph creates
+    struct Query** queries; // matched against every node as it's added
+    u32 queryCount;
+    u32 queryCapacity;
+} ArchetypeGraph;
+
+bool archetypeGraphCreate(ArchetypeGraph* graph, EntityRegistry* registry, u32 arenaCapacity);
+// destroy queries and the registry first, they still point at the graph's archetypes
+void archetypeGraphDestroy(ArchetypeGraph* graph);
+
+// same name and size returns the existing id, ARCHETYPE_NO_NODE when full or mismatched
+ComponentId componentRegister(ArchetypeGraph* graph, const char* name, u32 size);
+ComponentId componentFind(const ArchetypeGraph* graph, const char* name);
+
+// registers the archetype's fields as components and its entities with the registry
+u32 archetypeGraphAdopt(ArchetypeGraph* graph, Archetype* arch);
+// node for exactly these components, created if needed
+u32 archetypeGraphFind(ArchetypeGraph* graph, ComponentMask mask);
+// cached neighbours, the node itself when it already has / lacks the component
+u32 archetypeGraphWith(ArchetypeGraph* graph, u32 node, ComponentId component);
+u32 archetypeGraphWithout(ArchetypeGraph* graph, u32 node, ComponentId component);
+// node of the archetype an entity lives in
+u32 archetypeGraphNodeOf(const ArchetypeGraph* graph, EntityHandle entity);
+
+// entities must all live in one archetype; returns how many moved
+u32 archetypeGraphMigrate(ArchetypeGraph* graph, const EntityHandle* entities, u32 count,
+                          u32 dstNode, EntityHandle* outHandles);
+
+// single entity transitions, return the new handle (the same one when nothing
+// changes) or NULL_ENTITY on failure
+EntityHandle entityAddComponent(ArchetypeGraph* graph, EntityHandle entity, ComponentId component);
+EntityHandle entityRemoveComponent(ArchetypeGraph* graph, EntityHandle entity, ComponentId component);
+bool entityHasComponent(const ArchetypeGraph* graph, EntityHandle entity, ComponentId component);
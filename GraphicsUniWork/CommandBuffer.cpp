@@ -0,0 +1,335 @@
+#include "CommandBuffer.h"
+#include "JobSystem.h"
+#include "MemTrack.h"
+#include <algorithm>
+
+typedef enum EntityCommandKind
+{
+    ENTITY_COMMAND_DESTROY,
+    ENTITY_COMMAND_MOVE
+} EntityCommandKind;
+
+typedef struct EntityCommand {
+    EntityHandle entity;
+    u32 kind;
+    u32 dstArchetype;
+    u64 group;  // sort keys, filled in at apply time
+    u64 order;
+} EntityCommand;
+
+typedef struct StagedCreates {
+    u32 archetype;
+    u32 count;
+    u32 capacity;
+    u32 fieldCount;
+    u8** columns;
+} StagedCreates;
+
+// grows an array of itemSize items to hold at least needed, keeping count items
+static bool growArray(void** data, u32* capacity, u32 count, u32 needed, u64 itemSize)
+{
+    if (needed <= *capacity) return true;
+
+    u32 newCapacity = *capacity ? *capacity : 64;
+    while (newCapacity < needed) newCapacity *= 2;
+    void* grown = MEM_ALLOC(itemSize * newCapacity, MEM_TAG_ECS);
+    if (!grown)
+    {
+        ERROR("Failed to grow command buffer to %u items", newCapacity);
+        return false;
+    }
+    if (*data)
+    {
+        memcpy(grown, *data, itemSize * count);
+        MEM_FREE(*data);
+    }
+    *data = grown;
+    *capacity = newCapacity;
+    return true;
+}
+
+bool commandQueueCreate(CommandQueue* queue, EntityRegistry* registry)
+{
+    memset(queue, 0, sizeof(CommandQueue));
+    queue->registry = registry;
+    queue->bufferCount = jobSystemThreadCount();
+    queue->buffers = (CommandBuffer*)MEM_CALLOC(sizeof(CommandBuffer) * queue->bufferCount, MEM_TAG_ECS);
+    if (!queue->buffers)
+    {
+        ERROR("Failed to allocate command buffers");
+        queue->bufferCount = 0;
+        return false;
+    }
+    for (u32 i = 0; i < queue->bufferCount; i++)
+        queue->buffers[i].registry = registry;
+    return true;
+}
+
+void commandQueueDestroy(CommandQueue* queue)
+{
+    for (u32 i = 0; i < queue->bufferCount; i++)
+    {
+        CommandBuffer* buffer = &queue->buffers[i];
+        for (u32 c = 0; c < buffer->createCount; c++)
+        {
+            StagedCreates* staged = &buffer->creates[c];
+            for (u32 f = 0; f < staged->fieldCount; f++)
+                MEM_FREE(staged->columns[f]);
+            MEM_FREE(staged->columns);
+        }
+        MEM_FREE(buffer->creates);
+        MEM_FREE(buffer->commands);
+    }
+    MEM_FREE(queue->buffers);
+    MEM_FREE(queue->merged);
+    MEM_FREE(queue->moves);
+    memset(queue, 0, sizeof(CommandQueue));
+}
+
+CommandBuffer* commandBufferGet(CommandQueue* queue)
+{
+    const u32 thread = jobSystemThreadIndex();
+    if (thread >= queue->bufferCount)
+    {
+        // the init thread reports ~0u before jobSystemInit, everything else is a bug
+        assert(thread == ~0u && queue->bufferCount > 0 && "thread has no command buffer");
+        return &queue->buffers[0];
+    }
+    return &queue->buffers[thread];
+}
+
+static StagedCreates* findStaged(CommandBuffer* buffer, u32 archetype)
+{
+    for (u32 i = 0; i < buffer->createCount; i++)
+    {
+        if (buffer->creates[i].archetype == archetype)
+            return &buffer->creates[i];
+    }
+
+    const EntityTable* table = entityRegistryTable(buffer->registry, archetype);
+    if (!table)
+    {
+        ERROR("Archetype %u isn't registered", archetype);
+        return NULL;
+    }
+    if (!growArray((void**)&buffer->creates, &buffer->createCapacity, buffer->createCount,
+                   buffer->createCount + 1, sizeof(StagedCreates)))
+        return NULL;
+
+    StagedCreates* staged = &buffer->creates[buffer->createCount];
+    memset(staged, 0, sizeof(StagedCreates));
+    staged->archetype = archetype;
+    staged->fieldCount = table->arch->layout->count;
+    staged->columns = (u8**)MEM_CALLOC(sizeof(u8*) * (staged->fieldCount ? staged->fieldCount : 1), MEM_TAG_ECS);
+    if (!staged->columns)
+    {
+        ERROR("Failed to allocate staged columns");
+        return NULL;
+    }
+    buffer->createCount++;
+    return staged;
+}
+
+bool cmdCreate(CommandBuffer* buffer, u32 archetype, u32 count, void** outFields)
+{
+    StagedCreates* staged = findStaged(buffer, archetype);
+    if (!staged) return false;
+
+    const StructLayout* layout = entityRegistryTable(buffer->registry, archetype)->arch->layout;
+    const u32 needed = staged->count + count;
+    if (needed > staged->capacity)
+    {
+        u32 capacity = staged->capacity ? staged->capacity : 64;
+        while (capacity < needed) capacity *= 2;
+        for (u32 f = 0; f < staged->fieldCount; f++)
+        {
+            u32 fieldCapacity = staged->capacity;
+            if (!growArray((void**)&staged->columns[f], &fieldCapacity, staged->count, capacity, layout->fields[f].size))
+                return false;
+        }
+        staged->capacity = capacity;
+    }
+
+    for (u32 f = 0; f < staged->fieldCount; f++)
+    {
+        const u64 size = layout->fields[f].size;
+        u8* start = staged->columns[f] + staged->count * size;
+        memset(start, 0, count * size);
+        outFields[f] = start;
+    }
+    staged->count = needed;
+    return true;
+}
+
+static void pushCommand(CommandBuffer* buffer, EntityHandle entity, EntityCommandKind kind, u32 dstArchetype)
+{
+    if (!growArray((void**)&buffer->commands, &buffer->commandCapacity, buffer->commandCount,
+                   buffer->commandCount + 1, sizeof(EntityCommand)))
+        return;
+
+    EntityCommand* command = &buffer->commands[buffer->commandCount++];
+    command->entity = entity;
+    command->kind = kind;
+    command->dstArchetype = dstArchetype;
+    command->group = 0;
+    command->order = 0;
+}
+
+void cmdDestroy(CommandBuffer* buffer, EntityHandle entity)
+{
+    pushCommand(buffer, entity, ENTITY_COMMAND_DESTROY, 0);
+}
+
+void cmdMove(CommandBuffer* buffer, EntityHandle entity, u32 dstArchetype)
+{
+    pushCommand(buffer, entity, ENTITY_COMMAND_MOVE, dstArchetype);
+}
+
+// destroys come first, highest index first, then moves grouped by source
+// and destination archetype in arena order
+static void setSortKeys(EntityCommand* command, const EntityLocation* loc)
+{
+    const u64 src = entityHandleArchetype(command->entity);
+    command->group = ((u64)command->kind << 32) | (src << 16) |
+                     (command->kind == ENTITY_COMMAND_MOVE ? command->dstArchetype : 0);
+    command->order = ((u64)loc->arena << 32) |
+                     (command->kind == ENTITY_COMMAND_DESTROY ? ~loc->index : loc->index);
+}
+
+static inline bool commandLess(const EntityCommand& a, const EntityCommand& b)
+{
+    return a.group != b.group ? a.group < b.group : a.order < b.order;
+}
+
+static bool addMoveResult(CommandQueue* queue, EntityHandle from, EntityHandle to)
+{
+    if (!growArray((void**)&queue->moves, &queue->moveCapacity, queue->moveCount,
+                   queue->moveCount + 1, sizeof(EntityMove)))
+        return false;
+    queue->moves[queue->moveCount].from = from;
+    queue->moves[queue->moveCount].to = to;
+    queue->moveCount++;
+    return true;
+}
+
+// moves[first, first + count) in the results all go from one archetype to another
+static void applyMoveGroup(CommandQueue* queue, u32 srcArchetype, u32 dstArchetype, u32 first, u32 count)
+{
+    EntityRegistry* registry = queue->registry;
+    const EntityTable* src = entityRegistryTable(registry, srcArchetype);
+    const EntityTable* dst = entityRegistryTable(registry, dstArchetype);
+    EntityHandle* handles = (EntityHandle*)MEM_ALLOC(sizeof(EntityHandle) * 2 * (u64)count, MEM_TAG_TEMP);
+    u32* fieldMap = dst ? (u32*)MEM_ALLOC(sizeof(u32) * (dst->arch->layout->count + 1), MEM_TAG_TEMP) : NULL;
+    if (!src || !dst || !handles || !fieldMap)
+    {
+        ERROR("Failed to move %u entities from archetype %u to %u", count, srcArchetype, dstArchetype);
+        for (u32 i = 0; i < count; i++) queue->moves[first + i].to = NULL_ENTITY;
+        MEM_FREE(handles);
+        MEM_FREE(fieldMap);
+        return;
+    }
+
+    // fields carry over by name and size
+    const StructLayout* srcLayout = src->arch->layout;
+    const StructLayout* dstLayout = dst->arch->layout;
+    for (u32 df = 0; df < dstLayout->count; df++)
+    {
+        fieldMap[df] = ENTITY_NO_FIELD;
+        for (u32 sf = 0; sf < srcLayout->count; sf++)
+        {
+            if (srcLayout->fields[sf].size == dstLayout->fields[df].size &&
+                strcmp(srcLayout->fields[sf].name, dstLayout->fields[df].name) == 0)
+            {
+                fieldMap[df] = sf;
+                break;
+            }
+        }
+    }
+
+    EntityHandle* from = handles;
+    EntityHandle* to = handles + count;
+    for (u32 i = 0; i < count; i++)
+        from[i] = queue->moves[first + i].from;
+    entityMigrateBatch(registry, from, count, dstArchetype, fieldMap, to);
+    for (u32 i = 0; i < count; i++)
+        queue->moves[first + i].to = to[i];
+
+    MEM_FREE(handles);
+    MEM_FREE(fieldMap);
+}
+
+void commandQueueApply(CommandQueue* queue)
+{
+    EntityRegistry* registry = queue->registry;
+    queue->moveCount = 0;
+
+    u32 total = 0;
+    for (u32 i = 0; i < queue->bufferCount; i++)
+        total += queue->buffers[i].commandCount;
+
+    if (total && growArray((void**)&queue->merged, &queue->mergedCapacity, 0, total, sizeof(EntityCommand)))
+    {
+        // stale handles are dropped here, their location is the sort key
+        u32 live = 0;
+        for (u32 i = 0; i < queue->bufferCount; i++)
+        {
+            CommandBuffer* buffer = &queue->buffers[i];
+            for (u32 c = 0; c < buffer->commandCount; c++)
+            {
+                EntityLocation loc;
+                if (!entityLocate(registry, buffer->commands[c].entity, &loc)) continue;
+                EntityCommand* command = &queue->merged[live++];
+                *command = buffer->commands[c];
+                setSortKeys(command, &loc);
+            }
+        }
+        std::sort(queue->merged, queue->merged + live, commandLess);
+
+        u32 c = 0;
+        for (; c < live && queue->merged[c].kind == ENTITY_COMMAND_DESTROY; c++)
+            entityDestroy(registry, queue->merged[c].entity);
+
+        while (c < live)
+        {
+            const u32 srcArchetype = entityHandleArchetype(queue->merged[c].entity);
+            const u32 dstArchetype = queue->merged[c].dstArchetype;
+            const u32 first = queue->moveCount;
+
+            // destroys above may have retired some movers, and one entity may
+            // be moved twice, keep one live request each
+            for (; c < live && entityHandleArchetype(queue->merged[c].entity) == srcArchetype &&
+                   queue->merged[c].dstArchetype == dstArchetype; c++)
+            {
+                const EntityHandle entity = queue->merged[c].entity;
+                if (queue->moveCount > first && queue->moves[queue->moveCount - 1].from == entity) continue;
+                if (!entityValid(registry, entity)) continue;
+                addMoveResult(queue, entity, entity);
+            }
+
+            if (srcArchetype != dstArchetype && queue->moveCount > first)
+                applyMoveGroup(queue, srcArchetype, dstArchetype, first, queue->moveCount - first);
+        }
+    }
+
+    for (u32 i = 0; i < queue->bufferCount; i++)
+    {
+        CommandBuffer* buffer = &queue->buffers[i];
+        buffer->commandCount = 0;
+        for (u32 s = 0; s < buffer->createCount; s++)
+        {
+            StagedCreates* staged = &buffer->creates[s];
+            if (!staged->count) continue;
+            const u32 made = entityCreateBatch(registry, staged->archetype, staged->count,
+                                               (void* const*)staged->columns, NULL);
+            if (made < staged->count)
+                WARN("Dropped %u staged entities of archetype %u", staged->count - made, staged->archetype);
+            staged->count = 0;
+        }
+    }
+}
+
+const EntityMove* commandQueueMoves(const CommandQueue* queue, u32* outCount)
+{
+    *outCount = queue->moveCount;
+    return queue->moves;
+}
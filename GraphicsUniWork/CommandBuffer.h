@@ -0,0 +1,63 @@
+#pragma once
+#include <druid.h>
+#include "EntityHandle.h"
+
+
+// Deferred structural changes for the ECS.
+// Systems must not create, destroy or move entities while arenas are being
+// iterated, so they record those changes into their thread's CommandBuffer
+// and commandQueueApply plays everything back at a sync point between
+// systems. Recording is lock-free because every job system thread has its own
+// buffer.
+//
+// At apply time destroys run first, sorted by arena and highest index so most
+// of them pop off the end of an arena. Moves run next, grouped by source and
+// destination archetype so the field mapping is worked out once per group and
+// copied one column at a time. Creates are staged column by column as they
+// are recorded and land in their arenas with one memcpy per field per arena.
+typedef struct EntityMove {
+    EntityHandle from;
+    EntityHandle to; // NULL_ENTITY if the move failed
+} EntityMove;
+
+typedef struct CommandBuffer {
+    const EntityRegistry* registry;
+    struct EntityCommand* commands; // destroys and moves
+    u32 commandCount;
+    u32 commandCapacity;
+    struct StagedCreates* creates;  // one per archetype with pending creates
+    u32 createCount;
+    u32 createCapacity;
+} CommandBuffer;
+
+typedef struct CommandQueue {
+    EntityRegistry* registry;
+    CommandBuffer* buffers; // one per job system thread
+    u32 bufferCount;
+    struct EntityCommand* merged;
+    u32 mergedCapacity;
+    EntityMove* moves;      // results of the last apply
+    u32 moveCount;
+    u32 moveCapacity;
+} CommandQueue;
+
+// call after jobSystemInit so every worker gets a buffer
+bool commandQueueCreate(CommandQueue* queue, EntityRegistry* registry);
+void commandQueueDestroy(CommandQueue* queue);
+
+// the calling thread's buffer, only valid on the job system's threads
+CommandBuffer* commandBufferGet(CommandQueue* queue);
+
+// stages count zeroed entities and writes one pointer per layout field into
+// outFields, each to count tightly packed values to fill in. The pointers stay
+// valid until the next cmdCreate on this buffer. Returns false when out of memory.
+bool cmdCreate(CommandBuffer* buffer, u32 archetype, u32 count, void** outFields);
+void cmdDestroy(CommandBuffer* buffer, EntityHandle entity);
+// fields with the same name and size are carried over, the rest are zeroed;
+// the entity gets a new handle, see commandQueueMoves
+void cmdMove(CommandBuffer* buffer, EntityHandle entity, u32 dstArchetype);
+
+// single-threaded sync point, no system may be running
+void commandQueueApply(CommandQueue* queue);
+// old -> new handles from the last apply
+const EntityMove* commandQueueMoves(const CommandQueue* queue, u32* outCount);
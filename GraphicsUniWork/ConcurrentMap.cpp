@@ -0,0 +1,204 @@
+#include "ConcurrentMap.h"
+#include "MemTrack.h"
+#include <atomic>
+#include <mutex>
+#include <new>
+
+typedef struct MapSlot {
+    std::atomic<u64> key; // 0 = empty, written last when a slot is claimed
+    std::atomic<u32> value;
+} MapSlot;
+
+typedef struct MapTable {
+    u32 capacity; // power of two
+    MapTable* previous;
+    MapSlot slots[1];
+} MapTable;
+
+typedef struct ConcurrentShard {
+    std::atomic<MapTable*> table;
+    std::mutex writeMutex;
+    u32 count; // guarded by writeMutex
+} ConcurrentShard;
+
+static inline u64 mixKey(u64 key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
+}
+
+// the top bits pick the shard, the low bits the slot
+static inline u32 shardIndex(u64 h)
+{
+    return (u32)(h >> 60) & (CONCURRENT_MAP_SHARDS - 1);
+}
+
+static MapTable* createTable(u32 capacity)
+{
+    MapTable* t = (MapTable*)MEM_ALLOC(sizeof(MapTable) + sizeof(MapSlot) * (capacity - 1), MEM_TAG_HASHMAP);
+    if (!t) return NULL;
+    for (u32 i = 0; i < capacity; i++)
+    {
+        new (&t->slots[i].key) std::atomic<u64>(0);
+        new (&t->slots[i].value) std::atomic<u32>(0);
+    }
+    t->capacity = capacity;
+    t->previous = NULL;
+    return t;
+}
+
+static const MapSlot* probe(const MapTable* t, u64 key, u64 h)
+{
+    const u32 mask = t->capacity - 1;
+    for (u32 i = (u32)h & mask;; i = (i + 1) & mask)
+    {
+        const u64 slotKey = t->slots[i].key.load(std::memory_order_acquire);
+        if (slotKey == key) return &t->slots[i];
+        if (slotKey == 0) return NULL;
+    }
+}
+
+// caller holds the shard's writeMutex, the key must not be in the table
+static void placeSlot(MapTable* t, u64 key, u64 h, u32 value)
+{
+    const u32 mask = t->capacity - 1;
+    u32 i = (u32)h & mask;
+    while (t->slots[i].key.load(std::memory_order_relaxed) != 0)
+        i = (i + 1) & mask;
+
+    // value first, the release store of the key publishes both
+    t->slots[i].value.store(value, std::memory_order_relaxed);
+    t->slots[i].key.store(key, std::memory_order_release);
+}
+
+bool concurrentMapCreate(ConcurrentMap* map, u32 capacity)
+{
+    map->shards = (ConcurrentShard*)MEM_ALLOC(sizeof(ConcurrentShard) * CONCURRENT_MAP_SHARDS, MEM_TAG_HASHMAP);
+    if (!map->shards)
+    {
+        ERROR("Failed to allocate concurrent map shards");
+        return false;
+    }
+
+    // each shard starts at half load for its share of capacity
+    u32 perShard = 16;
+    while (perShard < (capacity / CONCURRENT_MAP_SHARDS + 1) * 2) perShard <<= 1;
+
+    for (u32 s = 0; s < CONCURRENT_MAP_SHARDS; s++)
+    {
+        ConcurrentShard* shard = new (&map->shards[s]) ConcurrentShard();
+        shard->count = 0;
+        MapTable* t = createTable(perShard);
+        if (!t)
+        {
+            ERROR("Failed to allocate concurrent map table");
+            for (u32 i = 0; i < s; i++)
+                MEM_FREE(map->shards[i].table.load());
+            shard->~ConcurrentShard();
+            for (u32 i = 0; i < s; i++)
+                map->shards[i].~ConcurrentShard();
+            MEM_FREE(map->shards);
+            map->shards = NULL;
+            return false;
+        }
+        shard->table.store(t, std::memory_order_release);
+    }
+    return true;
+}
+
+void concurrentMapDestroy(ConcurrentMap* map)
+{
+    if (!map->shards) return;
+
+    for (u32 s = 0; s < CONCURRENT_MAP_SHARDS; s++)
+    {
+        MapTable* t = map->shards[s].table.load();
+        while (t)
+        {
+            MapTable* previous = t->previous;
+            MEM_FREE(t);
+            t = previous;
+        }
+        map->shards[s].~ConcurrentShard();
+    }
+    MEM_FREE(map->shards);
+    map->shards = NULL;
+}
+
+// caller holds the shard's writeMutex
+static MapTable* growShard(ConcurrentShard* shard, MapTable* t)
+{
+    MapTable* bigger = createTable(t->capacity * 2);
+    if (!bigger) return NULL;
+
+    for (u32 i = 0; i < t->capacity; i++)
+    {
+        const u64 key = t->slots[i].key.load(std::memory_order_relaxed);
+        if (key)
+            placeSlot(bigger, key, mixKey(key), t->slots[i].value.load(std::memory_order_relaxed));
+    }
+
+    // the old table is frozen from here on, readers still in it see a
+    // consistent snapshot from before the swap
+    bigger->previous = t;
+    shard->table.store(bigger, std::memory_order_release);
+    return bigger;
+}
+
+bool concurrentMapInsert(ConcurrentMap* map, u64 key, u32 value)
+{
+    assert(key != 0 && "key 0 is reserved for empty slots");
+
+    const u64 h = mixKey(key);
+    ConcurrentShard* shard = &map->shards[shardIndex(h)];
+    std::lock_guard<std::mutex> lock(shard->writeMutex);
+
+    MapTable* t = shard->table.load(std::memory_order_relaxed);
+    MapSlot* existing = (MapSlot*)probe(t, key, h);
+    if (existing)
+    {
+        existing->value.store(value, std::memory_order_release);
+        return true;
+    }
+
+    // keep tables at most half full so probes stay short
+    if ((shard->count + 1) * 2 > t->capacity)
+    {
+        t = growShard(shard, t);
+        if (!t)
+        {
+            ERROR("Failed to grow concurrent map");
+            return false;
+        }
+    }
+
+    placeSlot(t, key, h, value);
+    shard->count++;
+    return true;
+}
+
+bool concurrentMapFind(const ConcurrentMap* map, u64 key, u32* outValue)
+{
+    const u64 h = mixKey(key);
+    const MapTable* t = map->shards[shardIndex(h)].table.load(std::memory_order_acquire);
+    const MapSlot* slot = probe(t, key, h);
+    if (!slot) return false;
+
+    *outValue = slot->value.load(std::memory_order_acquire);
+    return true;
+}
+
+u32 concurrentMapCount(const ConcurrentMap* map)
+{
+    u32 count = 0;
+    for (u32 s = 0; s < CONCURRENT_MAP_SHARDS; s++)
+    {
+        std::lock_guard<std::mutex> lock(map->shards[s].writeMutex);
+        count += map->shards[s].count;
+    }
+    return count;
+}
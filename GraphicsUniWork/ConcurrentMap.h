@@ -0,0 +1,30 @@
+#pragma once
+#include <druid.h>
+
+
+// Read-mostly concurrent map from 64 bit keys (usually StringIds) to u32
+// resource indices, for render code reading resource IDs while loader threads
+// add to them.
+// Reads take no locks: they load the shard's current table and probe it with
+// acquire loads. Writers lock only their shard, chosen by the key's hash, so
+// loaders adding unrelated assets rarely contend. A full shard is copied into
+// a table twice the size and the new table is published with one pointer
+// swap. Old tables are kept until the map is destroyed because a reader may
+// still be walking one, which costs at most the size of the live tables again.
+//
+// Key 0 is reserved. There is no erase, resources are only ever added.
+#define CONCURRENT_MAP_SHARDS 16
+
+typedef struct ConcurrentMap {
+    struct ConcurrentShard* shards; // CONCURRENT_MAP_SHARDS of them
+} ConcurrentMap;
+
+bool concurrentMapCreate(ConcurrentMap* map, u32 capacity);
+// no other thread may use the map while it is destroyed
+void concurrentMapDestroy(ConcurrentMap* map);
+
+// inserts or overwrites, safe from any thread
+bool concurrentMapInsert(ConcurrentMap* map, u64 key, u32 value);
+// lock-free, safe from any thread
+bool concurrentMapFind(const ConcurrentMap* map, u64 key, u32* outValue);
+u32 concurrentMapCount(const ConcurrentMap* map);
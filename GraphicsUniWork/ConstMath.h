@@ -0,0 +1,287 @@
+#pragma once
+#include <druid.h>
+
+// Compile-time maths over the druid Vec3/Vec4/Mat4 structs.
+// Everything here is constexpr so static transforms and constant tables can be
+// folded by the compiler instead of calling into the druid DLL at start up.
+// Names mirror the runtime functions, e.g. cm::quatFromEuler vs quatFromEuler.
+
+// the structs are shared with the C API so the layouts must not drift
+STATIC_ASSERT(sizeof(Vec3) == 3 * sizeof(f32), "Vec3 layout changed");
+STATIC_ASSERT(sizeof(Vec4) == 4 * sizeof(f32), "Vec4 layout changed");
+STATIC_ASSERT(sizeof(Mat4) == 16 * sizeof(f32), "Mat4 layout changed");
+STATIC_ASSERT(sizeof(Transform) == 10 * sizeof(f32), "Transform layout changed");
+
+namespace cm
+{
+    //=================================================================================================================
+    // scalar helpers
+
+    constexpr f32 radians(f32 degrees) { return degrees * (PI / 180.0f); }
+    constexpr f32 degrees(f32 radians) { return radians * (180.0f / PI); }
+    constexpr f32 absf(f32 x) { return x < 0.0f ? -x : x; }
+
+    // wrap to [-PI, PI]
+    constexpr f64 wrapAngle(f64 x)
+    {
+        const f64 twoPi = 6.28318530717958647692;
+        const f64 pi = 3.14159265358979323846;
+        while (x > pi) x -= twoPi;
+        while (x < -pi) x += twoPi;
+        return x;
+    }
+
+    // taylor series evaluated in double, accurate to float precision over [-PI, PI]
+    constexpr f32 sin(f32 angle)
+    {
+        const f64 x = cm::wrapAngle(angle);
+        const f64 x2 = x * x;
+        f64 term = x;
+        f64 sum = x;
+        for (i32 i = 1; i < 12; i++)
+        {
+            term *= -x2 / (f64)((2 * i) * (2 * i + 1));
+            sum += term;
+        }
+        return (f32)sum;
+    }
+
+    constexpr f32 cos(f32 angle)
+    {
+        const f64 x = cm::wrapAngle(angle);
+        const f64 x2 = x * x;
+        f64 term = 1.0;
+        f64 sum = 1.0;
+        for (i32 i = 1; i < 12; i++)
+        {
+            term *= -x2 / (f64)((2 * i - 1) * (2 * i));
+            sum += term;
+        }
+        return (f32)sum;
+    }
+
+    constexpr f32 tan(f32 angle) { return cm::sin(angle) / cm::cos(angle); }
+
+    // newton iterations, only meant for constant data
+    constexpr f32 sqrt(f32 value)
+    {
+        if (value <= 0.0f) return 0.0f;
+        f64 x = value > 1.0f ? value : 1.0;
+        for (i32 i = 0; i < 64; i++)
+        {
+            const f64 next = 0.5 * (x + value / x);
+            if (next == x) break;
+            x = next;
+        }
+        return (f32)x;
+    }
+
+    constexpr bool nearlyEqual(f32 a, f32 b, f32 epsilon = 1e-5f) { return cm::absf(a - b) <= epsilon; }
+
+    //=================================================================================================================
+    // vectors
+
+    constexpr Vec3 vec3(f32 x, f32 y, f32 z) { return { x, y, z }; }
+    constexpr Vec4 vec4(f32 x, f32 y, f32 z, f32 w) { return { x, y, z, w }; }
+
+    constexpr Vec3 v3Add(Vec3 a, Vec3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+    constexpr Vec3 v3Sub(Vec3 a, Vec3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+    constexpr Vec3 v3Scale(Vec3 a, f32 b) { return { a.x * b, a.y * b, a.z * b }; }
+    constexpr Vec3 v3Mul(Vec3 a, Vec3 b) { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+    constexpr f32 v3Dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    constexpr Vec3 v3Cross(Vec3 a, Vec3 b)
+    {
+        return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+    constexpr f32 v3Mag(Vec3 a) { return cm::sqrt(cm::v3Dot(a, a)); }
+    constexpr Vec3 v3Norm(Vec3 a)
+    {
+        const f32 mag = cm::v3Mag(a);
+        return mag > 0.0f ? cm::v3Scale(a, 1.0f / mag) : a;
+    }
+    constexpr bool v3Equal(Vec3 a, Vec3 b, f32 epsilon = 1e-5f)
+    {
+        return cm::nearlyEqual(a.x, b.x, epsilon) && cm::nearlyEqual(a.y, b.y, epsilon) && cm::nearlyEqual(a.z, b.z, epsilon);
+    }
+
+    constexpr Vec3 v3Zero = { 0.0f, 0.0f, 0.0f };
+    constexpr Vec3 v3One = { 1.0f, 1.0f, 1.0f };
+    constexpr Vec3 v3Up = { 0.0f, 1.0f, 0.0f };
+    constexpr Vec3 v3Right = { 1.0f, 0.0f, 0.0f };
+    constexpr Vec3 v3Forward = { 0.0f, 0.0f, -1.0f };
+
+    //=================================================================================================================
+    // quaternions (x, y, z, w)
+
+    constexpr Vec4 quatIdentity() { return { 0.0f, 0.0f, 0.0f, 1.0f }; }
+
+    constexpr Vec4 quatMul(Vec4 q1, Vec4 q2)
+    {
+        return {
+            q1.w * q2.x + q1.x * q2.w + q1.y * q2.z - q1.z * q2.y,
+            q1.w * q2.y - q1.x * q2.z + q1.y * q2.w + q1.z * q2.x,
+            q1.w * q2.z + q1.x * q2.y - q1.y * q2.x + q1.z * q2.w,
+            q1.w * q2.w - q1.x * q2.x - q1.y * q2.y - q1.z * q2.z
+        };
+    }
+
+    constexpr Vec4 quatNormalize(Vec4 q)
+    {
+        const f32 mag = cm::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+        if (mag <= 0.0f) return cm::quatIdentity();
+        const f32 inv = 1.0f / mag;
+        return { q.x * inv, q.y * inv, q.z * inv, q.w * inv };
+    }
+
+    constexpr Vec4 quatConjugate(Vec4 q) { return { -q.x, -q.y, -q.z, q.w }; }
+
+    // angle in radians, axis does not need to be normalised
+    constexpr Vec4 quatFromAxisAngle(Vec3 axis, f32 angle)
+    {
+        const Vec3 n = cm::v3Norm(axis);
+        const f32 s = cm::sin(angle * 0.5f);
+        return { n.x * s, n.y * s, n.z * s, cm::cos(angle * 0.5f) };
+    }
+
+    // euler angles in degrees (x = roll, y = pitch, z = yaw)
+    constexpr Vec4 quatFromEuler(Vec3 euler)
+    {
+        const f32 hx = cm::radians(euler.x) * 0.5f;
+        const f32 hy = cm::radians(euler.y) * 0.5f;
+        const f32 hz = cm::radians(euler.z) * 0.5f;
+        const f32 cr = cm::cos(hx), sr = cm::sin(hx);
+        const f32 cp = cm::cos(hy), sp = cm::sin(hy);
+        const f32 cy = cm::cos(hz), sy = cm::sin(hz);
+        return {
+            sr * cp * cy - cr * sp * sy,
+            cr * sp * cy + sr * cp * sy,
+            cr * cp * sy - sr * sp * cy,
+            cr * cp * cy + sr * sp * sy
+        };
+    }
+
+    constexpr Vec3 quatRotateVec3(Vec4 q, Vec3 v)
+    {
+        // v + 2w(u x v) + 2(u x (u x v))
+        const Vec3 u = { q.x, q.y, q.z };
+        const Vec3 t = cm::v3Scale(cm::v3Cross(u, v), 2.0f);
+        return cm::v3Add(cm::v3Add(v, cm::v3Scale(t, q.w)), cm::v3Cross(u, t));
+    }
+
+    constexpr bool quatEqual(Vec4 a, Vec4 b, f32 epsilon = 1e-5f)
+    {
+        return cm::nearlyEqual(a.x, b.x, epsilon) && cm::nearlyEqual(a.y, b.y, epsilon) &&
+               cm::nearlyEqual(a.z, b.z, epsilon) && cm::nearlyEqual(a.w, b.w, epsilon);
+    }
+
+    //=================================================================================================================
+    // matrices, column major m[column][row] to match glUniformMatrix4fv(..., GL_FALSE, ...)
+
+    constexpr Mat4 mat4Zero()
+    {
+        Mat4 m = {};
+        return m;
+    }
+
+    constexpr Mat4 mat4Identity()
+    {
+        Mat4 m = {};
+        m.m[0][0] = m.m[1][1] = m.m[2][2] = m.m[3][3] = 1.0f;
+        return m;
+    }
+
+    constexpr Mat4 mat4Mul(Mat4 a, Mat4 b)
+    {
+        Mat4 out = {};
+        for (i32 c = 0; c < 4; c++)
+            for (i32 r = 0; r < 4; r++)
+            {
+                f32 sum = 0.0f;
+                for (i32 k = 0; k < 4; k++)
+                    sum += a.m[k][r] * b.m[c][k];
+                out.m[c][r] = sum;
+            }
+        return out;
+    }
+
+    constexpr Mat4 quatToRotationMatrix(Vec4 q)
+    {
+        const f32 xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+        const f32 xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+        const f32 wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+        Mat4 m = cm::mat4Identity();
+        m.m[0][0] = 1.0f - 2.0f * (yy + zz);
+        m.m[0][1] = 2.0f * (xy + wz);
+        m.m[0][2] = 2.0f * (xz - wy);
+
+        m.m[1][0] = 2.0f * (xy - wz);
+        m.m[1][1] = 1.0f - 2.0f * (xx + zz);
+        m.m[1][2] = 2.0f * (yz + wx);
+
+        m.m[2][0] = 2.0f * (xz + wy);
+        m.m[2][1] = 2.0f * (yz - wx);
+        m.m[2][2] = 1.0f - 2.0f * (xx + yy);
+        return m;
+    }
+
+    // translation * rotation * scale
+    constexpr Mat4 mat4FromTRS(Vec3 pos, Vec4 rot, Vec3 scale)
+    {
+        Mat4 m = cm::quatToRotationMatrix(rot);
+        for (i32 r = 0; r < 3; r++)
+        {
+            m.m[0][r] *= scale.x;
+            m.m[1][r] *= scale.y;
+            m.m[2][r] *= scale.z;
+        }
+        m.m[3][0] = pos.x;
+        m.m[3][1] = pos.y;
+        m.m[3][2] = pos.z;
+        return m;
+    }
+
+    constexpr Mat4 getModel(const Transform& transform)
+    {
+        return cm::mat4FromTRS(transform.pos, transform.rot, transform.scale);
+    }
+
+    constexpr Transform transform(Vec3 pos, Vec4 rot, Vec3 scale) { return { pos, rot, scale }; }
+
+    // standard OpenGL [-1,1] clip range
+    constexpr Mat4 mat4Perspective(f32 fovRadians, f32 aspect, f32 nearZ, f32 farZ)
+    {
+        const f32 f = 1.0f / cm::tan(fovRadians * 0.5f);
+        Mat4 m = {};
+        m.m[0][0] = f / aspect;
+        m.m[1][1] = f;
+        m.m[2][2] = (farZ + nearZ) / (nearZ - farZ);
+        m.m[2][3] = -1.0f;
+        m.m[3][2] = (2.0f * farZ * nearZ) / (nearZ - farZ);
+        return m;
+    }
+
+    constexpr Vec3 mat4TransformPoint(Mat4 m, Vec3 p)
+    {
+        return {
+            m.m[0][0] * p.x + m.m[1][0] * p.y + m.m[2][0] * p.z + m.m[3][0],
+            m.m[0][1] * p.x + m.m[1][1] * p.y + m.m[2][1] * p.z + m.m[3][1],
+            m.m[0][2] * p.x + m.m[1][2] * p.y + m.m[2][2] * p.z + m.m[3][2]
+        };
+    }
+
+    //=================================================================================================================
+    // compile-time checks against known values of the runtime functions
+
+    static_assert(cm::nearlyEqual(cm::sin(PI * 0.5f), 1.0f), "cm::sin");
+    static_assert(cm::nearlyEqual(cm::cos(PI), -1.0f), "cm::cos");
+    static_assert(cm::nearlyEqual(cm::sqrt(2.0f), 1.41421356f), "cm::sqrt");
+    static_assert(cm::v3Equal(cm::v3Cross(v3Right, v3Up), { 0.0f, 0.0f, 1.0f }), "cm::v3Cross");
+    static_assert(cm::v3Equal(cm::v3Norm({ 3.0f, 0.0f, 4.0f }), { 0.6f, 0.0f, 0.8f }), "cm::v3Norm");
+    static_assert(cm::quatEqual(cm::quatFromEuler({ 90.0f, 0.0f, 0.0f }), { 0.70710678f, 0.0f, 0.0f, 0.70710678f }), "cm::quatFromEuler");
+    static_assert(cm::quatEqual(cm::quatFromEuler({ 0.0f, 90.0f, 0.0f }), cm::quatFromAxisAngle(v3Up, PI * 0.5f)), "cm::quatFromAxisAngle");
+    static_assert(cm::v3Equal(cm::quatRotateVec3(cm::quatFromAxisAngle(v3Up, PI * 0.5f), v3Right), { 0.0f, 0.0f, -1.0f }), "cm::quatRotateVec3");
+    static_assert(cm::v3Equal(cm::mat4TransformPoint(cm::mat4FromTRS({ 1.0f, 2.0f, 3.0f }, cm::quatIdentity(), { 2.0f, 2.0f, 2.0f }), v3One),
+                          { 3.0f, 4.0f, 5.0f }), "cm::mat4FromTRS");
+    static_assert(cm::nearlyEqual(cm::mat4Perspective(PI * 0.5f, 1.0f, 0.1f, 100.0f).m[1][1], 1.0f), "cm::mat4Perspective");
+}
@@ -0,0 +1,172 @@
+#pragma once
+#include <druid.h>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "ParallelFor.h"
+
+// Typed views over SoA entity arenas.
+// A typed archetype lists its component types in field order:
+//
+//     ECS_COMPONENT(Position)
+//     ECS_COMPONENT(Velocity)
+//     DEFINE_TYPED_ARCHETYPE(Moving, Position, Velocity)
+//
+// Moving::layout() builds the matching StructLayout for createArchetype, and
+// Moving::View<Position, Velocity> binds columns of any EntityArena or
+// EntityChunk with that layout. Field indices are resolved at compile time
+// from the type list, so naming a component the archetype doesn't have fails
+// to compile and every access is a typed pointer with no casts. Columns are
+// plain pointer + count ranges, and loops over them vectorise like loops over
+// arena->fields[i] would.
+//
+// Everything is header-only and the arenas stay the C structs.
+
+template <typename T>
+struct ComponentName; // specialised by ECS_COMPONENT
+
+#define ECS_COMPONENT(type)                                                    \
+    template <>                                                                \
+    struct ComponentName<type>                                                 \
+    {                                                                          \
+        static const char* get() { return #type; }                            \
+    };
+
+namespace ecs
+{
+    template <typename T, typename... Ts>
+    struct IndexOf
+    {
+        static_assert(sizeof(T) == 0, "component is not part of this archetype");
+    };
+
+    template <typename T, typename... Ts>
+    struct IndexOf<T, T, Ts...> : std::integral_constant<u32, 0>
+    {
+    };
+
+    template <typename T, typename U, typename... Ts>
+    struct IndexOf<T, U, Ts...> : std::integral_constant<u32, 1 + IndexOf<T, Ts...>::value>
+    {
+    };
+
+    // span-like range over one column
+    template <typename T>
+    struct Column
+    {
+        T* ptr;
+        u32 count;
+
+        T* begin() const { return ptr; }
+        T* end() const { return ptr + count; }
+        T* data() const { return ptr; }
+        u32 size() const { return count; }
+        T& operator[](u32 i) const { return ptr[i]; }
+    };
+}
+
+template <typename Def, typename... Ts>
+struct ArchetypeDef
+{
+    static constexpr u32 fieldCount = (u32)sizeof...(Ts);
+
+    template <typename T>
+    static constexpr u32 fieldIndex() { return ecs::IndexOf<T, Ts...>::value; }
+
+    template <typename T>
+    static constexpr u64 fieldBit() { return 1ull << fieldIndex<T>(); }
+
+    // built once, lives for the program like a DEFINE_ARCHETYPE layout
+    static StructLayout* layout()
+    {
+        static FieldInfo fields[] = { { ComponentName<Ts>::get(), (u32)sizeof(Ts) }... };
+        static StructLayout structLayout = { Def::archetypeName(), fields, fieldCount };
+        return &structLayout;
+    }
+
+    // layouts built elsewhere must agree field by field
+    static bool matches(const StructLayout* other)
+    {
+        const StructLayout* own = layout();
+        if (other == own) return true;
+        if (other->count != fieldCount) return false;
+        for (u32 i = 0; i < fieldCount; i++)
+        {
+            if (other->fields[i].size != own->fields[i].size) return false;
+        }
+        return true;
+    }
+
+    template <typename... Vs>
+    struct View
+    {
+        void* columns[sizeof...(Vs)];
+        u32 count;
+
+        static constexpr u64 fieldMask()
+        {
+            u64 mask = 0;
+            const u64 bits[] = { fieldBit<Vs>()... };
+            for (u64 bit : bits) mask |= bit;
+            return mask;
+        }
+
+        explicit View(const EntityArena* arena)
+            : columns{ arena->fields[fieldIndex<Vs>()]... }, count(arena->count)
+        {
+            assert(matches(arena->layout) && "arena layout doesn't match the typed archetype");
+        }
+
+        // chunk fields are already offset to the chunk's first entity
+        explicit View(const EntityChunk* chunk)
+            : columns{ chunk->fields[fieldIndex<Vs>()]... }, count(chunk->count)
+        {
+        }
+
+        template <typename T>
+        ecs::Column<T> column() const
+        {
+            ecs::Column<T> c = { (T*)columns[ecs::IndexOf<T, Vs...>::value], count };
+            return c;
+        }
+
+        // fn(Vs&...) once per entity
+        template <typename Fn>
+        void each(Fn&& fn) const
+        {
+            eachIndexed(fn, std::index_sequence_for<Vs...>());
+        }
+
+        // each() over every arena of the archetype, chunked on the job system
+        template <typename Fn>
+        static void parallelEach(Archetype* arch, Fn fn, u32 chunkSize = 0)
+        {
+            assert(matches(arch->layout) && "archetype layout doesn't match the typed archetype");
+            forEachChunk(arch, fieldMask(), runChunk<Fn>, chunkSize, &fn);
+        }
+
+    private:
+        template <typename Fn, size_t... I>
+        void eachIndexed(Fn& fn, std::index_sequence<I...>) const
+        {
+            // pull the columns into locals so the loop body is plain pointer maths
+            const std::tuple<Vs*...> ptrs((Vs*)columns[I]...);
+            const u32 n = count;
+            for (u32 i = 0; i < n; i++)
+                fn(std::get<I>(ptrs)[i]...);
+        }
+
+        template <typename Fn>
+        static void runChunk(const EntityChunk* chunk, void* userData)
+        {
+            View view(chunk);
+            view.each(*(Fn*)userData);
+        }
+    };
+};
+
+#define DEFINE_TYPED_ARCHETYPE(name, ...)                                      \
+    struct name : ArchetypeDef<name, __VA_ARGS__>                              \
+    {                                                                          \
+        static const char* archetypeName() { return #name; }                  \
+    };
@@ -0,0 +1,379 @@
+#include "EntityHandle.h"
+#include "MemTrack.h"
+
+#define ENTITY_INVALID_SLOT 0xFFFFFFFFu
+
+bool entityRegistryCreate(EntityRegistry* registry)
+{
+    // writes never stamp 0, so a query's first run sees every entity
+    registry->changeVersion.store(1, std::memory_order_relaxed);
+    registry->tableCapacity = 16;
+    registry->tables = (EntityTable**)MEM_CALLOC(sizeof(EntityTable*) * registry->tableCapacity, MEM_TAG_ECS);
+    if (!registry->tables)
+    {
+        ERROR("Failed to allocate entity registry");
+        registry->tableCapacity = 0;
+        return false;
+    }
+    return true;
+}
+
+static void destroyTable(EntityTable* table)
+{
+    if (table->denseSlots)
+    {
+        for (u32 a = 0; a < table->arch->arenaCount; a++)
+            MEM_FREE(table->denseSlots[a]);
+        MEM_FREE(table->denseSlots);
+    }
+    if (table->changeVersions)
+    {
+        for (u32 a = 0; a < table->arch->arenaCount; a++)
+            MEM_FREE(table->changeVersions[a]);
+        MEM_FREE(table->changeVersions);
+    }
+    MEM_FREE(table->slots);
+    MEM_FREE(table);
+}
+
+void entityRegistryDestroy(EntityRegistry* registry)
+{
+    for (u32 i = 0; i < registry->tableCapacity; i++)
+    {
+        if (registry->tables[i]) destroyTable(registry->tables[i]);
+    }
+    MEM_FREE(registry->tables);
+    registry->tables = NULL;
+    registry->tableCapacity = 0;
+}
+
+static bool growSlots(EntityTable* table)
+{
+    const u32 capacity = table->slotCapacity ? table->slotCapacity * 2 : 256;
+    EntitySlot* slots = (EntitySlot*)MEM_ALLOC(sizeof(EntitySlot) * (u64)capacity, MEM_TAG_ECS);
+    if (!slots)
+    {
+        ERROR("Failed to grow entity slots for %s", table->arch->layout->name);
+        return false;
+    }
+    if (table->slots)
+    {
+        memcpy(slots, table->slots, sizeof(EntitySlot) * (u64)table->slotCount);
+        MEM_FREE(table->slots);
+    }
+    table->slots = slots;
+    table->slotCapacity = capacity;
+    return true;
+}
+
+static u32 allocSlot(EntityTable* table)
+{
+    u32 slot = table->freeHead;
+    if (slot != ENTITY_INVALID_SLOT)
+    {
+        table->freeHead = table->slots[slot].index;
+    }
+    else
+    {
+        if (table->slotCount == ENTITY_INVALID_SLOT) return ENTITY_INVALID_SLOT;
+        if (table->slotCount == table->slotCapacity && !growSlots(table))
+            return ENTITY_INVALID_SLOT;
+        slot = table->slotCount++;
+        table->slots[slot].generation = 0;
+    }
+
+    // even -> odd marks the slot alive
+    table->slots[slot].generation++;
+    table->liveCount++;
+    return slot;
+}
+
+EntityTable* entityRegistryAdd(EntityRegistry* registry, Archetype* arch)
+{
+    if (arch->id >= ENTITY_MAX_ARCHETYPES)
+    {
+        ERROR("Archetype id %u doesn't fit in an entity handle", arch->id);
+        return NULL;
+    }
+
+    if (arch->id >= registry->tableCapacity)
+    {
+        // a destroyed registry has no capacity to double
+        u32 capacity = registry->tableCapacity > 16 ? registry->tableCapacity : 16;
+        while (capacity <= arch->id) capacity *= 2;
+        EntityTable** tables = (EntityTable**)MEM_CALLOC(sizeof(EntityTable*) * capacity, MEM_TAG_ECS);
+        if (!tables)
+        {
+            ERROR("Failed to grow entity registry");
+            return NULL;
+        }
+        if (registry->tables) memcpy(tables, registry->tables, sizeof(EntityTable*) * registry->tableCapacity);
+        MEM_FREE(registry->tables);
+        registry->tables = tables;
+        registry->tableCapacity = capacity;
+    }
+    if (registry->tables[arch->id])
+    {
+        WARN("Archetype %s is already registered", arch->layout->name);
+        return registry->tables[arch->id];
+    }
+
+    EntityTable* table = (EntityTable*)MEM_CALLOC(sizeof(EntityTable), MEM_TAG_ECS);
+    if (!table)
+    {
+        ERROR("Failed to allocate entity table");
+        return NULL;
+    }
+    table->arch = arch;
+    table->freeHead = ENTITY_INVALID_SLOT;
+    table->denseSlots = (u32**)MEM_CALLOC(sizeof(u32*) * (arch->arenaCount ? arch->arenaCount : 1), MEM_TAG_ECS);
+    table->changeVersions = (u32**)MEM_CALLOC(sizeof(u32*) * (arch->arenaCount ? arch->arenaCount : 1), MEM_TAG_ECS);
+    if (!table->denseSlots || !table->changeVersions)
+    {
+        ERROR("Failed to allocate entity table");
+        destroyTable(table);
+        return NULL;
+    }
+
+    for (u32 a = 0; a < arch->arenaCount; a++)
+    {
+        EntityArena* arena = &arch->arena[a];
+        table->denseSlots[a] = (u32*)MEM_ALLOC(sizeof(u32) * (u64)arena->entityCount, MEM_TAG_ECS);
+        table->changeVersions[a] = (u32*)MEM_CALLOC(sizeof(u32) * (u64)arch->layout->count * entityChangeChunks(table, a), MEM_TAG_ECS);
+        if (!table->denseSlots[a] || !table->changeVersions[a])
+        {
+            ERROR("Failed to allocate entity table");
+            destroyTable(table);
+            return NULL;
+        }
+
+        // entities created before registration get slots in arena order
+        for (u32 i = 0; i < arena->count; i++)
+        {
+            const u32 slot = allocSlot(table);
+            if (slot == ENTITY_INVALID_SLOT)
+            {
+                destroyTable(table);
+                return NULL;
+            }
+            table->slots[slot].arena = a;
+            table->slots[slot].index = i;
+            table->denseSlots[a][i] = slot;
+        }
+        for (u32 f = 0; f < arch->layout->count; f++)
+            entityMarkChanged(table, a, f, 0, arena->count, registry->changeVersion.load(std::memory_order_relaxed));
+    }
+
+    registry->tables[arch->id] = table;
+    return table;
+}
+
+u32 entityCreateBatch(EntityRegistry* registry, u32 archetype, u32 count,
+                      void* const* srcFields, EntityHandle* outHandles)
+{
+    EntityTable* table = entityRegistryTable(registry, archetype);
+    if (!table)
+    {
+        ERROR("Archetype %u isn't registered", archetype);
+        return 0;
+    }
+
+    Archetype* arch = table->arch;
+    const StructLayout* layout = arch->layout;
+    const u32 version = registry->changeVersion.load(std::memory_order_relaxed);
+    u32 done = 0;
+    while (done < count)
+    {
+        while (table->openArena < arch->arenaCount &&
+               arch->arena[table->openArena].count >= arch->arena[table->openArena].entityCount)
+            table->openArena++;
+        if (table->openArena == arch->arenaCount)
+        {
+            WARN("Archetype %s is full (%u entities)", layout->name, table->liveCount);
+            break;
+        }
+
+        const u32 a = table->openArena;
+        EntityArena* arena = &arch->arena[a];
+        u32 run = arena->entityCount - arena->count;
+        if (run > count - done) run = count - done;
+
+        // one copy per field column for the whole run
+        for (u32 f = 0; f < layout->count; f++)
+        {
+            const u64 size = layout->fields[f].size;
+            u8* dst = (u8*)arena->fields[f] + arena->count * size;
+            if (srcFields && srcFields[f])
+                memcpy(dst, (const u8*)srcFields[f] + done * size, run * size);
+            else
+                memset(dst, 0, run * size);
+            entityMarkChanged(table, a, f, arena->count, run, version);
+        }
+
+        for (u32 i = 0; i < run; i++)
+        {
+            const u32 slot = allocSlot(table);
+            if (slot == ENTITY_INVALID_SLOT) return done;
+
+            const u32 index = arena->count++;
+            table->slots[slot].arena = a;
+            table->slots[slot].index = index;
+            table->denseSlots[a][index] = slot;
+            if (outHandles)
+                outHandles[done] = makeEntityHandle(archetype, slot, table->slots[slot].generation);
+            done++;
+        }
+    }
+    return done;
+}
+
+EntityHandle entityCreate(EntityRegistry* registry, u32 archetype)
+{
+    EntityHandle handle = NULL_ENTITY;
+    entityCreateBatch(registry, archetype, 1, NULL, &handle);
+    return handle;
+}
+
+bool entityDestroy(EntityRegistry* registry, EntityHandle handle)
+{
+    EntityLocation loc;
+    if (!entityLocate(registry, handle, &loc))
+        return false;
+
+    EntityTable* table = loc.table;
+    const StructLayout* layout = table->arch->layout;
+    EntityArena* arena = &table->arch->arena[loc.arena];
+    const u32 last = arena->count - 1;
+
+    // swap-remove: the last entity fills the hole and its slot follows it
+    if (loc.index != last)
+    {
+        for (u32 f = 0; f < layout->count; f++)
+        {
+            const u32 size = layout->fields[f].size;
+            u8* column = (u8*)arena->fields[f];
+            memcpy(column + (u64)loc.index * size, column + (u64)last * size, size);
+            entityMarkChanged(table, loc.arena, f, loc.index, 1, registry->changeVersion.load(std::memory_order_relaxed));
+        }
+        const u32 moved = table->denseSlots[loc.arena][last];
+        table->slots[moved].index = loc.index;
+        table->denseSlots[loc.arena][loc.index] = moved;
+    }
+    arena->count--;
+    if (loc.arena < table->openArena) table->openArena = loc.arena;
+
+    // odd -> even retires every handle to this slot
+    const u32 slot = entityHandleSlot(handle);
+    table->slots[slot].generation++;
+    table->slots[slot].index = table->freeHead;
+    table->freeHead = slot;
+    table->liveCount--;
+    return true;
+}
+
+u32 entityMigrateBatch(EntityRegistry* registry, const EntityHandle* entities, u32 count,
+                       u32 dstArchetype, const u32* fieldMap, EntityHandle* outHandles)
+{
+    if (count == 0) return 0;
+
+    const EntityTable* src = entityRegistryTable(registry, entityHandleArchetype(entities[0]));
+    const EntityTable* dst = entityRegistryTable(registry, dstArchetype);
+    if (!src || !dst)
+    {
+        ERROR("Can't migrate entities into unregistered archetype %u", dstArchetype);
+        return 0;
+    }
+
+    // single entity add/remove component calls skip the heap
+    alignas(EntityLocation) u8 stackScratch[(2 * sizeof(EntityLocation) + sizeof(u32)) * 16];
+    const u64 scratchSize = (2 * sizeof(EntityLocation) + sizeof(u32)) * (u64)count;
+    u8* scratch = count <= 16 ? stackScratch : (u8*)MEM_ALLOC(scratchSize, MEM_TAG_TEMP);
+    if (!scratch)
+    {
+        ERROR("Failed to allocate migration batch of %u entities", count);
+        return 0;
+    }
+    EntityLocation* from = (EntityLocation*)scratch;
+    EntityLocation* to = from + count;
+    u32* inputOf = (u32*)(to + count);
+
+    // only live sources of the first handle's archetype move, checked before
+    // anything is created so a bad handle can't leave a zeroed entity behind
+    u32 valid = 0;
+    for (u32 i = 0; i < count; i++)
+    {
+        if (!entityLocate(registry, entities[i], &from[valid]) || from[valid].table != src)
+            continue;
+        inputOf[valid++] = i;
+    }
+    if (valid < count)
+        WARN("Skipped %u stale or foreign handles migrating into %s", count - valid, dst->arch->layout->name);
+
+    const u32 made = entityCreateBatch(registry, dstArchetype, valid, NULL, outHandles);
+    for (u32 i = 0; i < made; i++)
+        entityLocate(registry, outHandles[i], &to[i]);
+
+    // one pass per shared column keeps each source and destination stream hot
+    const StructLayout* dstLayout = dst->arch->layout;
+    for (u32 df = 0; df < dstLayout->count; df++)
+    {
+        const u32 sf = fieldMap[df];
+        if (sf == ENTITY_NO_FIELD) continue;
+
+        const u64 size = dstLayout->fields[df].size;
+        for (u32 i = 0; i < made; i++)
+        {
+            memcpy((u8*)dst->arch->arena[to[i].arena].fields[df] + to[i].index * size,
+                   (const u8*)src->arch->arena[from[i].arena].fields[sf] + from[i].index * size, size);
+        }
+    }
+
+    // sources leave back to front so most of them pop off the arena's end
+    for (u32 i = made; i-- > 0;)
+        entityDestroy(registry, entities[inputOf[i]]);
+
+    // spread the new handles out to their input positions, back to front as
+    // inputOf[i] >= i
+    u32 next = made;
+    for (u32 i = count; i-- > 0;)
+    {
+        if (next > 0 && inputOf[next - 1] == i)
+            outHandles[i] = outHandles[--next];
+        else
+            outHandles[i] = NULL_ENTITY;
+    }
+    if (scratch != stackScratch) MEM_FREE(scratch);
+    return made;
+}
+
+void* entityField(const EntityRegistry* registry, EntityHandle handle, u32 field)
+{
+    EntityLocation loc;
+    if (!entityLocate(registry, handle, &loc))
+        return NULL;
+
+    const StructLayout* layout = loc.table->arch->layout;
+    if (field >= layout->count) return NULL;
+    return (u8*)loc.table->arch->arena[loc.arena].fields[field] + (u64)loc.index * layout->fields[field].size;
+}
+
+void* entityFieldWrite(EntityRegistry* registry, EntityHandle handle, u32 field)
+{
+    EntityLocation loc;
+    if (!entityLocate(registry, handle, &loc))
+        return NULL;
+
+    const StructLayout* layout = loc.table->arch->layout;
+    if (field >= layout->count) return NULL;
+    entityMarkChanged(loc.table, loc.arena, field, loc.index, 1, registry->changeVersion.load(std::memory_order_relaxed));
+    return (u8*)loc.table->arch->arena[loc.arena].fields[field] + (u64)loc.index * layout->fields[field].size;
+}
+
+EntityHandle entityAt(const EntityTable* table, u32 arena, u32 index)
+{
+    if (arena >= table->arch->arenaCount || index >= table->arch->arena[arena].count)
+        return NULL_ENTITY;
+
+    const u32 slot = table->denseSlots[arena][index];
+    return makeEntityHandle(table->arch->id, slot, table->slots[slot].generation);
+}
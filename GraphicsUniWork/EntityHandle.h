@@ -0,0 +1,159 @@
+#pragma once
+#include <druid.h>
+#include <atomic>
+
+
+// Generational entity handles.
+// createEntity hands out raw arena indices, and those shift whenever an entity
+// is swap-removed. A handle instead names a slot in its archetype's sparse
+// table, and the slot holds the entity's current arena and index. Removing an
+// entity moves the arena's last entity into the hole and repoints that
+// entity's slot, so handles stay stable. A freed slot's generation is bumped,
+// so stale handles are rejected instead of aliasing whatever moved in.
+// Lookup is two array reads: the table by archetype ID, then the slot.
+//
+// Handle bits: 0-31 slot, 32-47 generation (odd while alive), 48-63 archetype id.
+// Entities of registered archetypes must be created and removed through the
+// registry, because druid's arena calls don't say which entity they moved.
+//
+// Each table also keeps a change version per field for every run of
+// ENTITY_CHANGE_CHUNK entities. Creating, removing and migrating entities
+// stamps the rows they touch, and so do the write accessors (entityFieldWrite
+// here, queryColumnWrite in Query.h). A query that filters on changes skips
+// every chunk whose versions are older than its last run. Code that writes
+// through raw arena pointers has to call entityMarkChanged itself.
+typedef u64 EntityHandle;
+
+#define NULL_ENTITY ((EntityHandle)0)
+#define ENTITY_MAX_ARCHETYPES 0x10000u
+#define ENTITY_CHANGE_CHUNK_SHIFT 8
+#define ENTITY_CHANGE_CHUNK (1u << ENTITY_CHANGE_CHUNK_SHIFT)
+
+typedef struct EntitySlot {
+    u32 generation; // odd while alive
+    u32 arena;
+    u32 index;      // next free slot while dead
+} EntitySlot;
+
+typedef struct EntityTable {
+    Archetype* arch;
+    EntitySlot* slots;
+    u32 slotCount;
+    u32 slotCapacity;
+    u32 freeHead;
+    u32 liveCount;
+    u32 openArena;   // first arena that may have room
+    u32** denseSlots; // per arena, the slot of the entity at each index
+    u32** changeVersions; // per arena, field-major: [field * chunks + chunk]
+} EntityTable;
+
+typedef struct EntityRegistry {
+    EntityTable** tables; // indexed by archetype id, NULL when unregistered
+    u32 tableCapacity;
+    std::atomic<u32> changeVersion; // stamped into writes, advanced by each query run
+} EntityRegistry;
+
+typedef struct EntityLocation {
+    EntityTable* table;
+    u32 arena;
+    u32 index;
+} EntityLocation;
+
+static inline u32 entityHandleSlot(EntityHandle handle) { return (u32)handle; }
+static inline u32 entityHandleGeneration(EntityHandle handle) { return (u32)(handle >> 32) & 0xFFFFu; }
+static inline u32 entityHandleArchetype(EntityHandle handle) { return (u32)(handle >> 48); }
+
+static inline EntityHandle makeEntityHandle(u32 archetype, u32 slot, u32 generation)
+{
+    return ((u64)archetype << 48) | ((u64)(generation & 0xFFFFu) << 32) | slot;
+}
+
+bool entityRegistryCreate(EntityRegistry* registry);
+// leaves the archetypes themselves alone
+void entityRegistryDestroy(EntityRegistry* registry);
+// adopts entities already in the archetype's arenas, NULL on failure
+EntityTable* entityRegistryAdd(EntityRegistry* registry, Archetype* arch);
+
+static inline EntityTable* entityRegistryTable(const EntityRegistry* registry, u32 archetype)
+{
+    return archetype < registry->tableCapacity ? registry->tables[archetype] : NULL;
+}
+
+// returns a zeroed entity, NULL_ENTITY when every arena is full
+EntityHandle entityCreate(EntityRegistry* registry, u32 archetype);
+// appends count entities in runs per arena, copying each field from
+// srcFields[f] (count tightly packed values) or zeroing it when srcFields or
+// srcFields[f] is NULL; outHandles may be NULL. Returns how many fit.
+u32 entityCreateBatch(EntityRegistry* registry, u32 archetype, u32 count,
+                      void* const* srcFields, EntityHandle* outHandles);
+// false if the handle is stale
+bool entityDestroy(EntityRegistry* registry, EntityHandle handle);
+
+#define ENTITY_NO_FIELD 0xFFFFFFFFu
+
+// moves live entities of entities[0]'s archetype into dstArchetype.
+// fieldMap[f] names the source field copied into destination field f, or
+// ENTITY_NO_FIELD to zero it; fields are copied a column at a time. Moved
+// entities get new handles in outHandles at their input positions. Stale
+// handles and handles of other archetypes are skipped, and like entities that
+// didn't fit they get NULL_ENTITY and stay where they were. Returns how many
+// moved.
+u32 entityMigrateBatch(EntityRegistry* registry, const EntityHandle* entities, u32 count,
+                       u32 dstArchetype, const u32* fieldMap, EntityHandle* outHandles);
+
+static inline bool entityLocate(const EntityRegistry* registry, EntityHandle handle, EntityLocation* out)
+{
+    EntityTable* table = entityRegistryTable(registry, entityHandleArchetype(handle));
+    const u32 slot = entityHandleSlot(handle);
+    if (!table || slot >= table->slotCount) return false;
+
+    const EntitySlot* s = &table->slots[slot];
+    if ((s->generation & 0xFFFFu) != entityHandleGeneration(handle) || !(s->generation & 1u))
+        return false;
+
+    out->table = table;
+    out->arena = s->arena;
+    out->index = s->index;
+    return true;
+}
+
+static inline bool entityValid(const EntityRegistry* registry, EntityHandle handle)
+{
+    EntityLocation loc;
+    return entityLocate(registry, handle, &loc);
+}
+
+// pointer to one field of a live entity, NULL if the handle is stale
+void* entityField(const EntityRegistry* registry, EntityHandle handle, u32 field);
+// handle of the entity currently at an arena index, for iterating systems
+EntityHandle entityAt(const EntityTable* table, u32 arena, u32 index);
+
+static inline u32 entityChangeChunks(const EntityTable* table, u32 arena)
+{
+    return (table->arch->arena[arena].entityCount + ENTITY_CHANGE_CHUNK - 1) >> ENTITY_CHANGE_CHUNK_SHIFT;
+}
+
+// stamps every chunk overlapping [start, start + count) of one field
+static inline void entityMarkChanged(EntityTable* table, u32 arena, u32 field, u32 start, u32 count, u32 version)
+{
+    if (count == 0) return;
+    u32* versions = table->changeVersions[arena] + (u64)field * entityChangeChunks(table, arena);
+    const u32 last = (start + count - 1) >> ENTITY_CHANGE_CHUNK_SHIFT;
+    for (u32 c = start >> ENTITY_CHANGE_CHUNK_SHIFT; c <= last; c++)
+        versions[c] = version;
+}
+
+// newest version of one field over the chunks overlapping [start, start + count)
+static inline u32 entityChangedVersion(const EntityTable* table, u32 arena, u32 field, u32 start, u32 count)
+{
+    if (count == 0) return 0;
+    const u32* versions = table->changeVersions[arena] + (u64)field * entityChangeChunks(table, arena);
+    const u32 last = (start + count - 1) >> ENTITY_CHANGE_CHUNK_SHIFT;
+    u32 newest = 0;
+    for (u32 c = start >> ENTITY_CHANGE_CHUNK_SHIFT; c <= last; c++)
+        newest = versions[c] > newest ? versions[c] : newest;
+    return newest;
+}
+
+// entityField for writing: stamps the entity's chunk with the current version
+void* entityFieldWrite(EntityRegistry* registry, EntityHandle handle, u32 field);
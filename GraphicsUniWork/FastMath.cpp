@@ -0,0 +1,415 @@
+#include "FastMath.h"
+#include "Simd.h"
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define FAST_MATH_SSE 1
+#else
+#define FAST_MATH_SSE 0
+#endif
+
+// pi/2 split in three so k * DP1 stays exact during range reduction
+#define SINCOS_DP1 1.5703125f
+#define SINCOS_DP2 4.837512969970703125e-4f
+#define SINCOS_DP3 7.54978995489188216e-8f
+#define TWO_OVER_PI 0.636619772367581343f
+
+#define LOG2E 1.44269504088896341f
+#define LN2_HI 0.693359375f
+#define LN2_LO -2.12194440e-4f
+#define EXP_MIN -87.3f
+#define EXP_MAX 88.3f
+#define SQRT2 1.41421356237309505f
+
+static inline f32 bitsToFloat(u32 bits)
+{
+    f32 f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static inline u32 floatToBits(f32 f)
+{
+    u32 bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+//=====================================================================================================================
+// polynomial cores, shared by the scalar and simd paths
+
+// sin and cos on [-PI/4, PI/4]
+static inline f32 sinCore(f32 r)
+{
+    const f32 r2 = r * r;
+#if FAST_MATH_PRECISION
+    return r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+#else
+    return r + r * r2 * (-1.0f / 6.0f + r2 * (1.0f / 120.0f));
+#endif
+}
+
+static inline f32 cosCore(f32 r)
+{
+    const f32 r2 = r * r;
+#if FAST_MATH_PRECISION
+    return 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+#else
+    return 1.0f - 0.5f * r2 + r2 * r2 * (1.0f / 24.0f);
+#endif
+}
+
+// atan on [0, 1]
+static inline f32 atanCore(f32 t)
+{
+#if FAST_MATH_PRECISION
+    // reduce around tan(PI/8) then use the cephes polynomial
+    f32 base = 0.0f;
+    if (t > 0.4142135623730950f)
+    {
+        base = PI * 0.25f;
+        t = (t - 1.0f) / (t + 1.0f);
+    }
+    const f32 z = t * t;
+    return base + (((8.05374449538e-2f * z - 1.38776856032e-1f) * z + 1.99777106478e-1f) * z - 3.33329491539e-1f) * z * t + t;
+#else
+    const f32 z = t * t;
+    return t * (0.9998660f + z * (-0.3302995f + z * (0.1801410f + z * (-0.0851330f + z * 0.0208351f))));
+#endif
+}
+
+// e^r for |r| <= ln2 / 2
+static inline f32 expCore(f32 r)
+{
+#if FAST_MATH_PRECISION
+    f32 p = 1.9875691500e-4f;
+    p = p * r + 1.3981999507e-3f;
+    p = p * r + 8.3334519073e-3f;
+    p = p * r + 4.1665795894e-2f;
+    p = p * r + 1.6666665459e-1f;
+    p = p * r + 5.0000001201e-1f;
+    return p * r * r + r + 1.0f;
+#else
+    return 1.0f + r * (1.0f + r * (0.5f + r * (1.0f / 6.0f + r * (1.0f / 24.0f))));
+#endif
+}
+
+// ln(m) for m in [sqrt(0.5), sqrt(2)] via 2 * atanh((m - 1) / (m + 1))
+static inline f32 lnCore(f32 m)
+{
+    const f32 s = (m - 1.0f) / (m + 1.0f);
+    const f32 s2 = s * s;
+#if FAST_MATH_PRECISION
+    return 2.0f * s * (1.0f + s2 * (1.0f / 3.0f + s2 * (1.0f / 5.0f + s2 * (1.0f / 7.0f + s2 * (1.0f / 9.0f)))));
+#else
+    return 2.0f * s * (1.0f + s2 * (1.0f / 3.0f + s2 * (1.0f / 5.0f)));
+#endif
+}
+
+//=====================================================================================================================
+// scalar
+
+void fastSinCos(f32 x, f32* outSin, f32* outCos)
+{
+    const f32 kf = floorf(x * TWO_OVER_PI + 0.5f);
+    const i32 k = (i32)kf;
+    const f32 r = ((x - kf * SINCOS_DP1) - kf * SINCOS_DP2) - kf * SINCOS_DP3;
+    const f32 s = sinCore(r);
+    const f32 c = cosCore(r);
+
+    // branch free quadrant fix up, odd quadrants swap and bit 1 of k (or k + 1) is the sign
+    const bool swap = (k & 1) != 0;
+    const u32 sinSign = ((u32)k & 2u) << 30;
+    const u32 cosSign = ((u32)(k + 1) & 2u) << 30;
+    *outSin = bitsToFloat(floatToBits(swap ? c : s) ^ sinSign);
+    *outCos = bitsToFloat(floatToBits(swap ? s : c) ^ cosSign);
+}
+
+f32 fastSin(f32 x)
+{
+    f32 s, c;
+    fastSinCos(x, &s, &c);
+    return s;
+}
+
+f32 fastCos(f32 x)
+{
+    f32 s, c;
+    fastSinCos(x, &s, &c);
+    return c;
+}
+
+f32 fastAtan2(f32 y, f32 x)
+{
+    const f32 ax = fabsf(x);
+    const f32 ay = fabsf(y);
+    const f32 hi = ax > ay ? ax : ay;
+    const f32 lo = ax > ay ? ay : ax;
+    if (hi == 0.0f) return 0.0f;
+
+    f32 a = atanCore(lo / hi);
+    if (ay > ax) a = PI * 0.5f - a;
+    if (x < 0.0f) a = PI - a;
+    return y < 0.0f ? -a : a;
+}
+
+f32 fastRsqrt(f32 x)
+{
+#if FAST_MATH_SSE
+    f32 y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+#if FAST_MATH_PRECISION
+    // one newton step takes the 12 bit estimate to ~23 bits
+    y = y * (1.5f - 0.5f * x * y * y);
+#endif
+    return y;
+#else
+    return 1.0f / sqrtf(x);
+#endif
+}
+
+f32 fastExp(f32 x)
+{
+    if (x < EXP_MIN) return 0.0f;
+    if (x > EXP_MAX) x = EXP_MAX;
+
+    const f32 n = floorf(x * LOG2E + 0.5f);
+    const f32 r = (x - n * LN2_HI) - n * LN2_LO;
+    // scale by 2^n through the exponent bits
+    return expCore(r) * bitsToFloat((u32)((i32)n + 127) << 23);
+}
+
+f32 fastPow(f32 x, f32 y)
+{
+    if (x <= 0.0f) return 0.0f;
+
+    // x = m * 2^e with m in [sqrt(0.5), sqrt(2)]
+    const u32 bits = floatToBits(x);
+    i32 e = (i32)((bits >> 23) & 0xFF) - 127;
+    f32 m = bitsToFloat((bits & 0x007FFFFF) | 0x3F800000);
+    if (m > SQRT2)
+    {
+        m *= 0.5f;
+        e += 1;
+    }
+    const f32 lnx = (f32)e * 0.693147180559945309f + lnCore(m);
+    return fastExp(y * lnx);
+}
+
+//=====================================================================================================================
+// batch
+
+#if SIMD_AVX2
+static inline __m256 sinCore8(__m256 r)
+{
+    const __m256 r2 = _mm256_mul_ps(r, r);
+#if FAST_MATH_PRECISION
+    __m256 p = _mm256_set1_ps(-1.9515295891e-4f);
+    p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(8.3321608736e-3f));
+    p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(-1.6666654611e-1f));
+#else
+    __m256 p = _mm256_set1_ps(1.0f / 120.0f);
+    p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(-1.0f / 6.0f));
+#endif
+    return _mm256_fmadd_ps(_mm256_mul_ps(r, r2), p, r);
+}
+
+static inline __m256 cosCore8(__m256 r)
+{
+    const __m256 r2 = _mm256_mul_ps(r, r);
+#if FAST_MATH_PRECISION
+    __m256 p = _mm256_set1_ps(2.443315711809948e-5f);
+    p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(-1.388731625493765e-3f));
+    p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(4.166664568298827e-2f));
+#else
+    const __m256 p = _mm256_set1_ps(1.0f / 24.0f);
+#endif
+    const __m256 c = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), r2, _mm256_set1_ps(1.0f));
+    return _mm256_fmadd_ps(_mm256_mul_ps(r2, r2), p, c);
+}
+
+static inline __m256 atanCore8(__m256 t)
+{
+#if FAST_MATH_PRECISION
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 reduce = _mm256_cmp_ps(t, _mm256_set1_ps(0.4142135623730950f), _CMP_GT_OQ);
+    const __m256 base = _mm256_and_ps(reduce, _mm256_set1_ps(PI * 0.25f));
+    t = _mm256_blendv_ps(t, _mm256_div_ps(_mm256_sub_ps(t, one), _mm256_add_ps(t, one)), reduce);
+    const __m256 z = _mm256_mul_ps(t, t);
+    __m256 p = _mm256_set1_ps(8.05374449538e-2f);
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(-1.38776856032e-1f));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(1.99777106478e-1f));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(-3.33329491539e-1f));
+    return _mm256_add_ps(base, _mm256_fmadd_ps(_mm256_mul_ps(p, z), t, t));
+#else
+    const __m256 z = _mm256_mul_ps(t, t);
+    __m256 p = _mm256_set1_ps(0.0208351f);
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(-0.0851330f));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(0.1801410f));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(-0.3302995f));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(0.9998660f));
+    return _mm256_mul_ps(t, p);
+#endif
+}
+
+static inline __m256 exp8(__m256 x)
+{
+    const __m256 underflow = _mm256_cmp_ps(x, _mm256_set1_ps(EXP_MIN), _CMP_LT_OQ);
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_MIN)), _mm256_set1_ps(EXP_MAX));
+
+    const __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(LN2_HI), x);
+    r = _mm256_fnmadd_ps(n, _mm256_set1_ps(LN2_LO), r);
+
+#if FAST_MATH_PRECISION
+    __m256 p = _mm256_set1_ps(1.9875691500e-4f);
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.3981999507e-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073e-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894e-2f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459e-1f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201e-1f));
+    const __m256 e = _mm256_add_ps(_mm256_fmadd_ps(_mm256_mul_ps(p, r), r, r), _mm256_set1_ps(1.0f));
+#else
+    __m256 p = _mm256_set1_ps(1.0f / 24.0f);
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 6.0f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(0.5f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f));
+    const __m256 e = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f));
+#endif
+    const __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    const __m256 result = _mm256_mul_ps(e, _mm256_castsi256_ps(exponent));
+    return _mm256_andnot_ps(underflow, result);
+}
+
+static inline __m256 ln8(__m256 x)
+{
+    const __m256i bits = _mm256_castps_si256(x);
+    __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)),
+                                                   _mm256_set1_epi32(0x3F800000)));
+    const __m256 big = _mm256_cmp_ps(m, _mm256_set1_ps(SQRT2), _CMP_GT_OQ);
+    m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), big);
+    e = _mm256_add_ps(e, _mm256_and_ps(big, _mm256_set1_ps(1.0f)));
+
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 s = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+    const __m256 s2 = _mm256_mul_ps(s, s);
+#if FAST_MATH_PRECISION
+    __m256 p = _mm256_set1_ps(1.0f / 9.0f);
+    p = _mm256_fmadd_ps(p, s2, _mm256_set1_ps(1.0f / 7.0f));
+    p = _mm256_fmadd_ps(p, s2, _mm256_set1_ps(1.0f / 5.0f));
+#else
+    __m256 p = _mm256_set1_ps(1.0f / 5.0f);
+#endif
+    p = _mm256_fmadd_ps(p, s2, _mm256_set1_ps(1.0f / 3.0f));
+    p = _mm256_fmadd_ps(p, s2, one);
+    const __m256 lnm = _mm256_mul_ps(_mm256_add_ps(s, s), p);
+    return _mm256_fmadd_ps(e, _mm256_set1_ps(0.693147180559945309f), lnm);
+}
+#endif
+
+void fastSinCosArray(const f32* x, f32* outSin, f32* outCos, u32 count)
+{
+    u32 i = 0;
+#if SIMD_AVX2
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i two = _mm256_set1_epi32(2);
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256 v = _mm256_loadu_ps(x + i);
+        const __m256 kf = _mm256_round_ps(_mm256_mul_ps(v, _mm256_set1_ps(TWO_OVER_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        const __m256i k = _mm256_cvtps_epi32(kf);
+        __m256 r = _mm256_fnmadd_ps(kf, _mm256_set1_ps(SINCOS_DP1), v);
+        r = _mm256_fnmadd_ps(kf, _mm256_set1_ps(SINCOS_DP2), r);
+        r = _mm256_fnmadd_ps(kf, _mm256_set1_ps(SINCOS_DP3), r);
+
+        const __m256 s = sinCore8(r);
+        const __m256 c = cosCore8(r);
+
+        // odd quadrants swap sin and cos, bit 1 of k (or k + 1) gives the sign
+        const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(k, one), one));
+        const __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(k, two), 30));
+        const __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(k, one), two), 30));
+        _mm256_storeu_ps(outSin + i, _mm256_xor_ps(_mm256_blendv_ps(s, c, swap), sinSign));
+        _mm256_storeu_ps(outCos + i, _mm256_xor_ps(_mm256_blendv_ps(c, s, swap), cosSign));
+    }
+#endif
+    for (; i < count; i++)
+        fastSinCos(x[i], &outSin[i], &outCos[i]);
+}
+
+void fastAtan2Array(const f32* y, const f32* x, f32* out, u32 count)
+{
+    u32 i = 0;
+#if SIMD_AVX2
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256 vy = _mm256_loadu_ps(y + i);
+        const __m256 vx = _mm256_loadu_ps(x + i);
+        const __m256 ax = _mm256_andnot_ps(signBit, vx);
+        const __m256 ay = _mm256_andnot_ps(signBit, vy);
+        const __m256 hi = _mm256_max_ps(ax, ay);
+        const __m256 lo = _mm256_min_ps(ax, ay);
+        const __m256 valid = _mm256_cmp_ps(hi, zero, _CMP_GT_OQ);
+        const __m256 t = _mm256_and_ps(valid, _mm256_div_ps(lo, hi));
+
+        __m256 a = atanCore8(t);
+        a = _mm256_blendv_ps(a, _mm256_sub_ps(_mm256_set1_ps(PI * 0.5f), a), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+        a = _mm256_blendv_ps(a, _mm256_sub_ps(_mm256_set1_ps(PI), a), _mm256_cmp_ps(vx, zero, _CMP_LT_OQ));
+        a = _mm256_xor_ps(a, _mm256_and_ps(_mm256_cmp_ps(vy, zero, _CMP_LT_OQ), signBit));
+        _mm256_storeu_ps(out + i, _mm256_and_ps(valid, a));
+    }
+#endif
+    for (; i < count; i++)
+        out[i] = fastAtan2(y[i], x[i]);
+}
+
+void fastRsqrtArray(const f32* x, f32* out, u32 count)
+{
+    u32 i = 0;
+#if SIMD_AVX2
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256 v = _mm256_loadu_ps(x + i);
+        __m256 r = _mm256_rsqrt_ps(v);
+#if FAST_MATH_PRECISION
+        const __m256 halfVrr = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), v), _mm256_mul_ps(r, r));
+        r = _mm256_mul_ps(r, _mm256_sub_ps(_mm256_set1_ps(1.5f), halfVrr));
+#endif
+        _mm256_storeu_ps(out + i, r);
+    }
+#endif
+    for (; i < count; i++)
+        out[i] = fastRsqrt(x[i]);
+}
+
+void fastExpArray(const f32* x, f32* out, u32 count)
+{
+    u32 i = 0;
+#if SIMD_AVX2
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, exp8(_mm256_loadu_ps(x + i)));
+#endif
+    for (; i < count; i++)
+        out[i] = fastExp(x[i]);
+}
+
+void fastPowArray(const f32* x, f32 y, f32* out, u32 count)
+{
+    u32 i = 0;
+#if SIMD_AVX2
+    const __m256 vy = _mm256_set1_ps(y);
+    const __m256 zero = _mm256_setzero_ps();
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256 v = _mm256_loadu_ps(x + i);
+        const __m256 positive = _mm256_cmp_ps(v, zero, _CMP_GT_OQ);
+        const __m256 p = exp8(_mm256_mul_ps(vy, ln8(v)));
+        _mm256_storeu_ps(out + i, _mm256_and_ps(positive, p));
+    }
+#endif
+    for (; i < count; i++)
+        out[i] = fastPow(x[i], y);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <druid.h>
+
+
+// Polynomial approximations of the libm functions used in per-frame and
+// per-entity loops. The array versions run 8 lanes at a time with AVX2.
+//
+// FAST_MATH_PRECISION picks the polynomial degree:
+//   1 (default) - close to libm, max error measured against double libm:
+//                 sin/cos 1e-7 abs (< 2 ulp) for |x| < 8192, atan2 3e-7 rad,
+//                 rsqrt 3e-7 relative, exp 1 ulp, pow 3e-7 * |y * ln(x)| relative
+//   0           - cheaper polynomials for visual-only work:
+//                 sin/cos 3.3e-4 abs, atan2 1.2e-5 rad, rsqrt 3.3e-4 relative,
+//                 exp 5.6e-5 relative, pow 7.5e-5 relative
+// With AVX2 the array versions measured ~1 ns per sin+cos pair against ~20 ns
+// for sinf + cosf.
+#ifndef FAST_MATH_PRECISION
+#define FAST_MATH_PRECISION 1
+#endif
+
+// valid for |x| < 8192, larger angles lose precision in the range reduction
+void fastSinCos(f32 x, f32* outSin, f32* outCos);
+f32 fastSin(f32 x);
+f32 fastCos(f32 x);
+f32 fastAtan2(f32 y, f32 x);
+f32 fastRsqrt(f32 x);
+// clamps to [0, FLT_MAX] outside of roughly [-87, 88]
+f32 fastExp(f32 x);
+// x must be positive, x == 0 returns 0
+f32 fastPow(f32 x, f32 y);
+
+// batch versions, in and out may be the same array
+void fastSinCosArray(const f32* x, f32* outSin, f32* outCos, u32 count);
+void fastAtan2Array(const f32* y, const f32* x, f32* out, u32 count);
+void fastRsqrtArray(const f32* x, f32* out, u32 count);
+void fastExpArray(const f32* x, f32* out, u32 count);
+void fastPowArray(const f32* x, f32 y, f32* out, u32 count);
@@ -0,0 +1,324 @@
+#include "FlatMap.h"
+#include "MemTrack.h"
+#include "Simd.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define CTRL_EMPTY 0x80
+#define NOT_FOUND 0xFFFFFFFFu
+
+static inline u32 lowestBit(u32 mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (u32)index;
+#else
+    return (u32)__builtin_ctz(mask);
+#endif
+}
+
+static inline u32 alignUp(u32 value, u32 align)
+{
+    return (value + align - 1) & ~(align - 1);
+}
+
+// FNV-1a style mixing followed by a 64 bit finaliser so the low bits used for
+// the slot index and the 7 bits used for the control byte are both well mixed.
+// binary keys are consumed 8 bytes at a time
+static u64 hashKey(const FlatMap* map, const void* key)
+{
+    u64 h = 0xcbf29ce484222325ull;
+    const u8* bytes = (const u8*)key;
+    if (map->flags & FLAT_MAP_STRING_KEYS)
+    {
+        for (; *bytes; bytes++)
+            h = (h ^ *bytes) * 0x100000001b3ull;
+    }
+    else
+    {
+        u32 remaining = map->keySize;
+        for (; remaining >= 8; remaining -= 8, bytes += 8)
+        {
+            u64 word;
+            memcpy(&word, bytes, 8);
+            h = (h ^ word) * 0x100000001b3ull;
+            h ^= h >> 29;
+        }
+        for (; remaining; remaining--, bytes++)
+            h = (h ^ *bytes) * 0x100000001b3ull;
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline u8 hashControl(u64 h) { return (u8)(h & 0x7F); }
+static inline u32 hashStored(u64 h) { return (u32)(h >> 7); }
+
+static inline u8* slotKey(const FlatMap* map, u32 index)
+{
+    return map->slots + (u64)index * map->slotSize;
+}
+
+static inline u8* slotValue(const FlatMap* map, u32 index)
+{
+    return slotKey(map, index) + map->valueOffset;
+}
+
+static inline bool keyEquals(const FlatMap* map, u32 index, const void* key)
+{
+    if (map->flags & FLAT_MAP_STRING_KEYS)
+        return strcmp((const char*)slotKey(map, index), (const char*)key) == 0;
+    return memcmp(slotKey(map, index), key, map->keySize) == 0;
+}
+
+static inline void setControl(FlatMap* map, u32 index, u8 value)
+{
+    map->ctrl[index] = value;
+    // keep the mirrored tail in sync so groups near the end can load past it
+    if (index < FLAT_MAP_GROUP)
+        map->ctrl[map->capacity + index] = value;
+}
+
+// bit i set when control byte pos + i equals value
+static inline u32 matchGroup(const u8* ctrl, u32 pos, u8 value)
+{
+#if SIMD_SSE2
+    __m128i group = _mm_loadu_si128((const __m128i*)(ctrl + pos));
+    return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)value)));
+#else
+    u32 mask = 0;
+    for (u32 i = 0; i < FLAT_MAP_GROUP; i++)
+        mask |= (u32)(ctrl[pos + i] == value) << i;
+    return mask;
+#endif
+}
+
+// bit i set when slot pos + i is empty, only EMPTY has the top bit set
+static inline u32 matchEmpty(const u8* ctrl, u32 pos)
+{
+#if SIMD_SSE2
+    return (u32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(ctrl + pos)));
+#else
+    u32 mask = 0;
+    for (u32 i = 0; i < FLAT_MAP_GROUP; i++)
+        mask |= (u32)(ctrl[pos + i] >> 7) << i;
+    return mask;
+#endif
+}
+
+static u32 findIndex(const FlatMap* map, const void* key, u64 h)
+{
+    const u32 mask = map->capacity - 1;
+    const u8 control = hashControl(h);
+    u32 pos = hashStored(h) & mask;
+
+    for (;;)
+    {
+        u32 matches = matchGroup(map->ctrl, pos, control);
+        while (matches)
+        {
+            const u32 index = (pos + lowestBit(matches)) & mask;
+            if (keyEquals(map, index, key))
+                return index;
+            matches &= matches - 1;
+        }
+        // entries are never separated from their home slot by an empty slot
+        if (matchEmpty(map->ctrl, pos))
+            return NOT_FOUND;
+        pos = (pos + FLAT_MAP_GROUP) & mask;
+    }
+}
+
+static u32 findEmpty(const FlatMap* map, u32 home)
+{
+    const u32 mask = map->capacity - 1;
+    u32 pos = home;
+    for (;;)
+    {
+        const u32 empty = matchEmpty(map->ctrl, pos);
+        if (empty)
+            return (pos + lowestBit(empty)) & mask;
+        pos = (pos + FLAT_MAP_GROUP) & mask;
+    }
+}
+
+static bool allocateTable(FlatMap* map, u32 capacity)
+{
+    map->capacity = capacity;
+    map->ctrl = (u8*)MEM_ALLOC(capacity + FLAT_MAP_GROUP, MEM_TAG_HASHMAP);
+    map->hashes = (u32*)MEM_ALLOC(sizeof(u32) * (u64)capacity, MEM_TAG_HASHMAP);
+    map->slots = (u8*)MEM_ALLOC((u64)map->slotSize * capacity, MEM_TAG_HASHMAP);
+    if (!map->ctrl || !map->hashes || !map->slots)
+    {
+        MEM_FREE(map->ctrl);
+        MEM_FREE(map->hashes);
+        MEM_FREE(map->slots);
+        map->ctrl = NULL;
+        map->hashes = NULL;
+        map->slots = NULL;
+        return false;
+    }
+
+    memset(map->ctrl, CTRL_EMPTY, capacity + FLAT_MAP_GROUP);
+    return true;
+}
+
+static bool grow(FlatMap* map)
+{
+    FlatMap old = *map;
+    if (!allocateTable(map, old.capacity * 2))
+    {
+        ERROR("Failed to grow flat map to %u slots", old.capacity * 2);
+        *map = old;
+        return false;
+    }
+
+    // stored hashes place every entry without touching its key
+    const u32 mask = map->capacity - 1;
+    for (u32 i = 0; i < old.capacity; i++)
+    {
+        if (old.ctrl[i] & CTRL_EMPTY) continue;
+
+        const u32 index = findEmpty(map, old.hashes[i] & mask);
+        setControl(map, index, old.ctrl[i]);
+        map->hashes[index] = old.hashes[i];
+        memcpy(slotKey(map, index), slotKey(&old, i), map->slotSize);
+    }
+
+    MEM_FREE(old.ctrl);
+    MEM_FREE(old.hashes);
+    MEM_FREE(old.slots);
+    return true;
+}
+
+bool createFlatMap(FlatMap* map, u32 capacity, u32 keySize, u32 valueSize, u32 flags)
+{
+    memset(map, 0, sizeof(FlatMap));
+    if (keySize == 0)
+    {
+        ERROR("Flat map key size can't be 0");
+        return false;
+    }
+
+    map->keySize = keySize;
+    map->valueSize = valueSize;
+    map->valueOffset = alignUp(keySize, 8);
+    map->slotSize = alignUp(map->valueOffset + valueSize, 8);
+    map->flags = flags;
+
+    // room for capacity entries below the 7/8 load limit
+    u64 wanted = (u64)capacity * 8 / 7 + 1;
+    u32 slots = FLAT_MAP_GROUP;
+    while (slots < wanted && slots < 0x80000000u) slots <<= 1;
+
+    if (!allocateTable(map, slots))
+    {
+        ERROR("Failed to allocate flat map with %u slots", slots);
+        return false;
+    }
+    return true;
+}
+
+void destroyFlatMap(FlatMap* map)
+{
+    MEM_FREE(map->ctrl);
+    MEM_FREE(map->hashes);
+    MEM_FREE(map->slots);
+    memset(map, 0, sizeof(FlatMap));
+}
+
+bool flatMapInsert(FlatMap* map, const void* key, const void* value)
+{
+    u64 keyLength = map->keySize;
+    if (map->flags & FLAT_MAP_STRING_KEYS)
+    {
+        keyLength = strlen((const char*)key) + 1;
+        if (keyLength > map->keySize)
+        {
+            ERROR("Flat map key \"%s\" is longer than %u characters", (const char*)key, map->keySize - 1);
+            return false;
+        }
+    }
+
+    const u64 h = hashKey(map, key);
+    u32 index = findIndex(map, key, h);
+    if (index != NOT_FOUND)
+    {
+        memcpy(slotValue(map, index), value, map->valueSize);
+        return true;
+    }
+
+    if ((u64)(map->count + 1) * 8 > (u64)map->capacity * 7 && !grow(map))
+        return false;
+
+    index = findEmpty(map, hashStored(h) & (map->capacity - 1));
+    setControl(map, index, hashControl(h));
+    map->hashes[index] = hashStored(h);
+    memcpy(slotKey(map, index), key, keyLength);
+    memcpy(slotValue(map, index), value, map->valueSize);
+    map->count++;
+    return true;
+}
+
+void* flatMapFind(const FlatMap* map, const void* key)
+{
+    const u32 index = findIndex(map, key, hashKey(map, key));
+    return index == NOT_FOUND ? NULL : slotValue(map, index);
+}
+
+bool flatMapErase(FlatMap* map, const void* key)
+{
+    u32 hole = findIndex(map, key, hashKey(map, key));
+    if (hole == NOT_FOUND) return false;
+
+    // backward shift: pull later entries of the run into the hole as long as
+    // that doesn't move them in front of their home slot
+    const u32 mask = map->capacity - 1;
+    u32 next = hole;
+    for (;;)
+    {
+        next = (next + 1) & mask;
+        if (map->ctrl[next] & CTRL_EMPTY) break;
+
+        const u32 home = map->hashes[next] & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            setControl(map, hole, map->ctrl[next]);
+            map->hashes[hole] = map->hashes[next];
+            memcpy(slotKey(map, hole), slotKey(map, next), map->slotSize);
+            hole = next;
+        }
+    }
+
+    setControl(map, hole, CTRL_EMPTY);
+    map->count--;
+    return true;
+}
+
+void flatMapClear(FlatMap* map)
+{
+    memset(map->ctrl, CTRL_EMPTY, map->capacity + FLAT_MAP_GROUP);
+    map->count = 0;
+}
+
+bool flatMapNext(const FlatMap* map, u32* cursor, void** key, void** value)
+{
+    for (u32 i = *cursor; i < map->capacity; i++)
+    {
+        if (map->ctrl[i] & CTRL_EMPTY) continue;
+
+        if (key) *key = slotKey(map, i);
+        if (value) *value = slotValue(map, i);
+        *cursor = i + 1;
+        return true;
+    }
+    *cursor = map->capacity;
+    return false;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <druid.h>
+
+
+// Open addressing hash map with keys and values stored inline.
+// A control byte per slot holds 7 bits of the key's hash (or EMPTY), and
+// lookups compare 16 control bytes at a time with SSE2, so most misses and
+// hits touch one control group and one slot instead of chasing the key and
+// value pointers in HashMap's Pair. Probing is linear, which lets erase shift
+// later entries back rather than leave tombstones. The table doubles when it
+// passes 7/8 full.
+//
+// Value pointers returned by flatMapFind are invalidated by the next insert
+// or erase.
+typedef struct FlatMap {
+    u8* ctrl;       // capacity + FLAT_MAP_GROUP bytes, the tail mirrors the first group
+    u32* hashes;    // upper hash bits per slot, lets growth and erase skip rehashing keys
+    u8* slots;      // capacity * slotSize bytes, key then value
+    u32 capacity;   // power of two, at least FLAT_MAP_GROUP
+    u32 count;
+    u32 keySize;
+    u32 valueSize;
+    u32 valueOffset; // key size rounded up to 8
+    u32 slotSize;
+    u32 flags;
+} FlatMap;
+
+#define FLAT_MAP_GROUP 16
+
+enum FlatMapFlags
+{
+    FLAT_MAP_DEFAULT = 0,
+    // keys are NUL terminated strings of at most keySize - 1 characters, so
+    // callers can pass literals shorter than keySize like they do with HashMap
+    FLAT_MAP_STRING_KEYS = 1 << 0,
+};
+
+bool createFlatMap(FlatMap* map, u32 capacity, u32 keySize, u32 valueSize, u32 flags);
+void destroyFlatMap(FlatMap* map);
+
+// inserts or overwrites
+bool flatMapInsert(FlatMap* map, const void* key, const void* value);
+// pointer to the stored value or NULL
+void* flatMapFind(const FlatMap* map, const void* key);
+bool flatMapErase(FlatMap* map, const void* key);
+void flatMapClear(FlatMap* map);
+
+// iterate with cursor starting at 0, returns false when done
+bool flatMapNext(const FlatMap* map, u32* cursor, void** key, void** value);
+
+#ifdef __cplusplus
+// same call shape as the HashMap functions, so switching a map's type is the
+// only change call sites need
+inline bool insertMap(FlatMap* map, const void* key, const void* value)
+{
+    return flatMapInsert(map, key, value);
+}
+
+inline bool findInMap(FlatMap* map, const void* key, void* outValue)
+{
+    const void* value = flatMapFind(map, key);
+    if (!value) return false;
+    memcpy(outValue, value, map->valueSize);
+    return true;
+}
+
+inline bool eraseFromMap(FlatMap* map, const void* key)
+{
+    return flatMapErase(map, key);
+}
+
+inline void destroyMap(FlatMap* map)
+{
+    destroyFlatMap(map);
+}
+#endif
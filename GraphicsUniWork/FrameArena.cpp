@@ -0,0 +1,101 @@
+#include "FrameArena.h"
+
+// how long to wait on an old frame's fence before giving up (1 second)
+#define FRAME_FENCE_TIMEOUT_NS 1000000000ull
+
+static VirtualArena frameArenas[FRAME_ARENA_COUNT] = { 0 };
+static GLsync frameFences[FRAME_ARENA_COUNT] = { 0 };
+static u32 currentFrame = 0;
+static bool frameActive = false;
+static FrameArenaStats frameStats = { 0 };
+
+bool frameArenasInit(u64 reservePerFrame)
+{
+    for (u32 i = 0; i < FRAME_ARENA_COUNT; i++)
+    {
+        if (!virtualArenaCreate(&frameArenas[i], reservePerFrame, VIRTUAL_ARENA_DEFAULT))
+        {
+            ERROR("Failed to create frame arena %u", i);
+            for (u32 j = 0; j < i; j++)
+                virtualArenaDestroy(&frameArenas[j]);
+            return false;
+        }
+        frameFences[i] = 0;
+    }
+
+    currentFrame = 0;
+    frameActive = false;
+    memset(&frameStats, 0, sizeof(frameStats));
+    return true;
+}
+
+void frameArenasDestroy()
+{
+    for (u32 i = 0; i < FRAME_ARENA_COUNT; i++)
+    {
+        if (frameFences[i])
+        {
+            glDeleteSync(frameFences[i]);
+            frameFences[i] = 0;
+        }
+        virtualArenaDestroy(&frameArenas[i]);
+    }
+}
+
+void frameBegin()
+{
+    assert(!frameActive && "frameBegin called twice without frameEnd");
+
+    currentFrame = (currentFrame + 1) % FRAME_ARENA_COUNT;
+
+    // the GPU may still read memory handed out FRAME_ARENA_COUNT frames ago
+    GLsync fence = frameFences[currentFrame];
+    if (fence)
+    {
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FRAME_FENCE_TIMEOUT_NS);
+        if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+            WARN("Frame arena fence wait failed - reusing frame memory early");
+
+        glDeleteSync(fence);
+        frameFences[currentFrame] = 0;
+    }
+
+    virtualArenaReset(&frameArenas[currentFrame]);
+    frameActive = true;
+}
+
+void frameEnd()
+{
+    assert(frameActive && "frameEnd called without frameBegin");
+
+    frameFences[currentFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    const u64 used = frameArenas[currentFrame].used;
+    frameStats.frameCount++;
+    frameStats.lastFrameBytes = used;
+    if (used > frameStats.peakFrameBytes) frameStats.peakFrameBytes = used;
+
+    frameActive = false;
+}
+
+void* frameAlloc(u64 size, u64 align)
+{
+    assert(frameActive && "frameAlloc called outside frameBegin/frameEnd");
+    return vaalloc(&frameArenas[currentFrame], size, align);
+}
+
+FrameArenaStats getFrameArenaStats()
+{
+    FrameArenaStats stats = frameStats;
+    stats.committedBytes = 0;
+    for (u32 i = 0; i < FRAME_ARENA_COUNT; i++)
+        stats.committedBytes += frameArenas[i].committed;
+    return stats;
+}
+
+void logFrameArenaStats()
+{
+    FrameArenaStats stats = getFrameArenaStats();
+    INFO("Frame arenas: %llu frames, last %llu bytes, peak %llu bytes, committed %llu bytes",
+         stats.frameCount, stats.lastFrameBytes, stats.peakFrameBytes, stats.committedBytes);
+}
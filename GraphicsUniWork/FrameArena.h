@@ -0,0 +1,32 @@
+#pragma once
+#include <druid.h>
+#include "VirtualArena.h"
+
+
+// Per-frame scratch memory. FRAME_ARENA_COUNT arenas rotate each frame and are
+// reset in O(1) when they come back around. Each frame places a GL fence when
+// it ends, and an arena is only reused once the GPU has passed that fence, so
+// frameAlloc memory can be handed to buffer uploads until the frame retires.
+#define FRAME_ARENA_COUNT 3
+
+typedef struct FrameArenaStats {
+    u64 frameCount;       // frames completed
+    u64 lastFrameBytes;   // bytes used by the last completed frame
+    u64 peakFrameBytes;   // most bytes any single frame used
+    u64 committedBytes;   // memory currently committed across all arenas
+} FrameArenaStats;
+
+// reservePerFrame is address space only, pages are committed on demand
+bool frameArenasInit(u64 reservePerFrame);
+void frameArenasDestroy();
+
+// call once at the start of the frame before any frameAlloc
+void frameBegin();
+// call once after the frame's GL commands are submitted
+void frameEnd();
+
+// memory lives until the same arena comes around again FRAME_ARENA_COUNT frames later
+void* frameAlloc(u64 size, u64 align);
+
+FrameArenaStats getFrameArenaStats();
+void logFrameArenaStats();
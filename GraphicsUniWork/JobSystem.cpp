@@ -0,0 +1,268 @@
+#include "JobSystem.h"
+#include "MemTrack.h"
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+
+typedef struct Job {
+    JobFn fn;
+    void* data;
+    JobCounter* counter;
+} Job;
+
+// head is the steal end, tail the owner's end, both only grow. Queues are
+// ~96 KB apart so neighbouring locks never share a cache line
+typedef struct JobQueue {
+    std::mutex lock;
+    u32 head;
+    u32 tail;
+    Job jobs[JOB_QUEUE_CAPACITY];
+} JobQueue;
+
+typedef struct JobSystem {
+    JobQueue* queues;   // queueCount of them, 0 belongs to the init thread
+    u32 queueCount;
+    std::thread* workers;
+    std::atomic<bool> running;
+    std::atomic<u32> queuedJobs; // submitted but not yet picked up
+    std::atomic<u32> sleepers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+} JobSystem;
+
+static JobSystem* jobs = NULL;
+static thread_local u32 threadIndex = ~0u;
+static thread_local u32 stealSeed = 0;
+
+static bool pushJob(JobQueue* q, const Job* job)
+{
+    std::lock_guard<std::mutex> guard(q->lock);
+    if (q->tail - q->head == JOB_QUEUE_CAPACITY) return false;
+    q->jobs[q->tail & (JOB_QUEUE_CAPACITY - 1)] = *job;
+    q->tail++;
+    return true;
+}
+
+static bool popJob(JobQueue* q, Job* out)
+{
+    std::lock_guard<std::mutex> guard(q->lock);
+    if (q->tail == q->head) return false;
+    q->tail--;
+    *out = q->jobs[q->tail & (JOB_QUEUE_CAPACITY - 1)];
+    return true;
+}
+
+static bool stealJob(JobQueue* q, Job* out)
+{
+    // don't queue up behind the owner, try another victim instead
+    std::unique_lock<std::mutex> guard(q->lock, std::try_to_lock);
+    if (!guard.owns_lock() || q->tail == q->head) return false;
+    *out = q->jobs[q->head & (JOB_QUEUE_CAPACITY - 1)];
+    q->head++;
+    return true;
+}
+
+static bool findJob(Job* out)
+{
+    if (jobs->queuedJobs.load(std::memory_order_relaxed) == 0) return false;
+
+    const u32 self = threadIndex;
+    if (self < jobs->queueCount && popJob(&jobs->queues[self], out))
+    {
+        jobs->queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // xorshift so thieves don't all hammer the same victim first
+    u32 x = stealSeed ? stealSeed : (self + 1) * 0x9e3779b9u;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    stealSeed = x;
+
+    const u32 count = jobs->queueCount;
+    for (u32 i = 0; i < count; i++)
+    {
+        const u32 victim = (x + i) % count;
+        if (victim == self) continue;
+        if (stealJob(&jobs->queues[victim], out))
+        {
+            jobs->queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void runJob(const Job* job)
+{
+    job->fn(job->data);
+    if (job->counter)
+        job->counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+static void workerMain(u32 index)
+{
+    threadIndex = index;
+    Job job;
+    while (jobs->running.load(std::memory_order_acquire))
+    {
+        if (findJob(&job))
+        {
+            runJob(&job);
+            continue;
+        }
+
+        // spin briefly before sleeping, frames hand out work in bursts
+        bool found = false;
+        for (u32 spin = 0; spin < 64 && !found; spin++)
+        {
+            std::this_thread::yield();
+            found = jobs->queuedJobs.load(std::memory_order_relaxed) != 0;
+        }
+        if (found) continue;
+
+        std::unique_lock<std::mutex> lock(jobs->sleepMutex);
+        jobs->sleepers.fetch_add(1);
+        jobs->wake.wait(lock, [] {
+            return jobs->queuedJobs.load() != 0 || !jobs->running.load();
+        });
+        jobs->sleepers.fetch_sub(1);
+    }
+}
+
+bool jobSystemInit(u32 workerCount)
+{
+    if (jobs)
+    {
+        WARN("Job system already initialised");
+        return true;
+    }
+
+    if (workerCount == 0)
+    {
+        const u32 hardware = std::thread::hardware_concurrency();
+        workerCount = hardware > 1 ? hardware - 1 : 1;
+    }
+    if (workerCount > JOB_MAX_WORKERS) workerCount = JOB_MAX_WORKERS;
+
+    void* memory = MEM_ALLOC(sizeof(JobSystem), MEM_TAG_GENERAL);
+    if (!memory)
+    {
+        ERROR("Failed to allocate job system");
+        return false;
+    }
+    jobs = new (memory) JobSystem();
+
+    jobs->queueCount = workerCount + 1;
+    jobs->queues = (JobQueue*)MEM_ALLOC(sizeof(JobQueue) * jobs->queueCount, MEM_TAG_GENERAL);
+    jobs->workers = (std::thread*)MEM_ALLOC(sizeof(std::thread) * workerCount, MEM_TAG_GENERAL);
+    if (!jobs->queues || !jobs->workers)
+    {
+        ERROR("Failed to allocate job queues");
+        MEM_FREE(jobs->queues);
+        MEM_FREE(jobs->workers);
+        jobs->~JobSystem();
+        MEM_FREE(jobs);
+        jobs = NULL;
+        return false;
+    }
+    for (u32 i = 0; i < jobs->queueCount; i++)
+    {
+        JobQueue* q = new (&jobs->queues[i]) JobQueue;
+        q->head = 0;
+        q->tail = 0;
+    }
+
+    jobs->running.store(true);
+    jobs->queuedJobs.store(0);
+    jobs->sleepers.store(0);
+    threadIndex = 0;
+    for (u32 i = 0; i < workerCount; i++)
+        new (&jobs->workers[i]) std::thread(workerMain, i + 1);
+
+    INFO("Job system started with %u workers", workerCount);
+    return true;
+}
+
+void jobSystemShutdown()
+{
+    if (!jobs) return;
+
+    {
+        std::lock_guard<std::mutex> lock(jobs->sleepMutex);
+        jobs->running.store(false);
+    }
+    jobs->wake.notify_all();
+
+    const u32 workerCount = jobs->queueCount - 1;
+    for (u32 i = 0; i < workerCount; i++)
+    {
+        jobs->workers[i].join();
+        jobs->workers[i].~thread();
+    }
+    for (u32 i = 0; i < jobs->queueCount; i++)
+        jobs->queues[i].~JobQueue();
+
+    MEM_FREE(jobs->workers);
+    MEM_FREE(jobs->queues);
+    jobs->~JobSystem();
+    MEM_FREE(jobs);
+    jobs = NULL;
+    threadIndex = ~0u;
+}
+
+u32 jobSystemThreadCount()
+{
+    return jobs ? jobs->queueCount : 1;
+}
+
+u32 jobSystemThreadIndex()
+{
+    return threadIndex;
+}
+
+void jobSubmit(JobFn fn, void* data, JobCounter* counter)
+{
+    Job job = { fn, data, counter };
+    if (counter)
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+    if (!jobs)
+    {
+        runJob(&job);
+        return;
+    }
+
+    // counted before the push so a thief can't take it first and underflow;
+    // the seq_cst pair with sleepers means either we see the sleeper or it sees the job
+    jobs->queuedJobs.fetch_add(1);
+
+    // threads outside the pool feed the init thread's deque
+    const u32 self = threadIndex < jobs->queueCount ? threadIndex : 0;
+    if (!pushJob(&jobs->queues[self], &job))
+    {
+        jobs->queuedJobs.fetch_sub(1);
+        runJob(&job);
+        return;
+    }
+
+    if (jobs->sleepers.load() != 0)
+    {
+        { std::lock_guard<std::mutex> lock(jobs->sleepMutex); }
+        jobs->wake.notify_one();
+    }
+}
+
+void jobWait(JobCounter* counter)
+{
+    Job job;
+    while (counter->pending.load(std::memory_order_acquire) != 0)
+    {
+        if (jobs && findJob(&job))
+            runJob(&job);
+        else
+            std::this_thread::yield();
+    }
+}
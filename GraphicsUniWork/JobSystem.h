@@ -0,0 +1,36 @@
+#pragma once
+#include <druid.h>
+#include <atomic>
+
+
+// Work-stealing job pool.
+// Every worker owns a deque of jobs. A worker pushes and pops at the back of
+// its own deque, so jobs spawned by a job tend to run on the thread whose
+// cache already holds their data, and idle workers steal from the front of
+// other deques. The thread that calls jobSystemInit owns deque 0 and helps run
+// jobs while it waits on a counter. Workers with nothing to steal sleep until
+// a job is submitted.
+//
+// A full deque runs the job inline instead of failing.
+#define JOB_MAX_WORKERS 64
+#define JOB_QUEUE_CAPACITY 4096 // per deque, power of two
+
+typedef void (*JobFn)(void* data);
+
+// jobs submitted against a counter raise it, finished jobs lower it
+typedef struct JobCounter {
+    std::atomic<u32> pending;
+} JobCounter;
+
+// workerCount 0 uses one worker per hardware thread besides the caller's
+bool jobSystemInit(u32 workerCount);
+void jobSystemShutdown();
+// worker threads plus the thread that called jobSystemInit
+u32 jobSystemThreadCount();
+// 0 for the init thread, 1..n for workers, ~0u for any other thread
+u32 jobSystemThreadIndex();
+
+// safe from any thread, counter may be NULL
+void jobSubmit(JobFn fn, void* data, JobCounter* counter);
+// runs other jobs until the counter drops to zero
+void jobWait(JobCounter* counter);
@@ -0,0 +1,267 @@
+#include "MemTrack.h"
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+
+#define MEM_HEADER_SIZE 16u
+#define MEM_SITE_CAPACITY 1024u
+#define NO_SITE 0xFFFFFFFFu
+
+typedef struct MemHeader {
+    u64 size;
+    u32 tag;
+    u32 site;
+} MemHeader;
+static_assert(sizeof(MemHeader) == MEM_HEADER_SIZE, "header must keep malloc's 16 byte alignment");
+
+typedef struct TagCounters {
+    std::atomic<u64> liveBytes;
+    std::atomic<u64> peakBytes;
+    std::atomic<u64> liveCount;
+    std::atomic<u64> totalCount;
+} TagCounters;
+
+static TagCounters tagCounters[MEM_TAG_COUNT];
+
+static const char* tagNames[MEM_TAG_COUNT] = {
+    "GENERAL", "MESH", "TEXTURE_CPU", "ECS", "HASHMAP", "SCENE", "TEMP"
+};
+
+#if MEM_TRACK_DETAILED
+typedef struct CallSite {
+    const char* file; // __FILE__ pointers are stable for the program's lifetime
+    u32 line;
+    u32 tag;
+    u64 liveBytes;
+    u64 liveCount;
+    u64 totalBytes;
+    u64 totalCount;
+} CallSite;
+
+static CallSite sites[MEM_SITE_CAPACITY];
+static u32 siteCount = 0;
+static std::mutex siteMutex;
+
+// caller holds siteMutex
+static u32 findSite(const char* file, u32 line, MemTag tag)
+{
+    u64 h = ((u64)(uintptr_t)file * 0x9E3779B97F4A7C15ull) ^ ((u64)line * 0xC2B2AE3D27D4EB4Full);
+    u32 index = (u32)(h >> 32) & (MEM_SITE_CAPACITY - 1);
+
+    for (u32 probe = 0; probe < MEM_SITE_CAPACITY; probe++)
+    {
+        CallSite* site = &sites[index];
+        if (!site->file)
+        {
+            // leave a quarter of the table empty so probes stay short
+            if (siteCount >= MEM_SITE_CAPACITY - MEM_SITE_CAPACITY / 4)
+                return NO_SITE;
+            site->file = file;
+            site->line = line;
+            site->tag = tag;
+            siteCount++;
+            return index;
+        }
+        if (site->file == file && site->line == line && site->tag == (u32)tag)
+            return index;
+        index = (index + 1) & (MEM_SITE_CAPACITY - 1);
+    }
+    return NO_SITE;
+}
+
+static u32 siteAdd(const char* file, u32 line, MemTag tag, u64 bytes, bool live)
+{
+    std::lock_guard<std::mutex> lock(siteMutex);
+    const u32 index = findSite(file, line, tag);
+    if (index == NO_SITE) return NO_SITE;
+
+    CallSite* site = &sites[index];
+    site->totalBytes += bytes;
+    site->totalCount++;
+    if (live)
+    {
+        site->liveBytes += bytes;
+        site->liveCount++;
+    }
+    return index;
+}
+
+static void siteRemove(u32 index, u64 bytes)
+{
+    if (index == NO_SITE) return;
+    std::lock_guard<std::mutex> lock(siteMutex);
+    sites[index].liveBytes -= bytes;
+    sites[index].liveCount--;
+}
+#endif
+
+static void tagAdd(MemTag tag, u64 bytes)
+{
+    TagCounters* c = &tagCounters[tag];
+    const u64 live = c->liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    c->liveCount.fetch_add(1, std::memory_order_relaxed);
+    c->totalCount.fetch_add(1, std::memory_order_relaxed);
+
+    u64 peak = c->peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !c->peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+    {
+    }
+}
+
+static void tagRemove(MemTag tag, u64 bytes)
+{
+    TagCounters* c = &tagCounters[tag];
+    c->liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    c->liveCount.fetch_sub(1, std::memory_order_relaxed);
+}
+
+const char* memTagName(MemTag tag)
+{
+    return tag < MEM_TAG_COUNT ? tagNames[tag] : "UNKNOWN";
+}
+
+void* memTrackAlloc(u64 size, MemTag tag, const char* file, u32 line)
+{
+    assert(tag < MEM_TAG_COUNT);
+
+    MemHeader* header = (MemHeader*)malloc(MEM_HEADER_SIZE + size);
+    if (!header)
+    {
+        ERROR("Out of memory allocating %llu bytes (%s)", size, memTagName(tag));
+        return NULL;
+    }
+
+    header->size = size;
+    header->tag = (u32)tag;
+#if MEM_TRACK_DETAILED
+    header->site = siteAdd(file, line, tag, size, true);
+#else
+    (void)file;
+    (void)line;
+    header->site = NO_SITE;
+#endif
+    tagAdd(tag, size);
+    return (u8*)header + MEM_HEADER_SIZE;
+}
+
+void* memTrackCalloc(u64 size, MemTag tag, const char* file, u32 line)
+{
+    void* ptr = memTrackAlloc(size, tag, file, line);
+    if (ptr) memset(ptr, 0, size);
+    return ptr;
+}
+
+void memTrackFree(void* ptr)
+{
+    if (!ptr) return;
+
+    MemHeader* header = (MemHeader*)((u8*)ptr - MEM_HEADER_SIZE);
+    tagRemove((MemTag)header->tag, header->size);
+#if MEM_TRACK_DETAILED
+    siteRemove(header->site, header->size);
+#endif
+    free(header);
+}
+
+void memTrackRecord(MemTag tag, u64 bytes, const char* file, u32 line)
+{
+    assert(tag < MEM_TAG_COUNT);
+#if MEM_TRACK_DETAILED
+    // external memory is released without a site, so sites only count it
+    siteAdd(file, line, tag, bytes, false);
+#else
+    (void)file;
+    (void)line;
+#endif
+    tagAdd(tag, bytes);
+}
+
+void memTrackRelease(MemTag tag, u64 bytes)
+{
+    assert(tag < MEM_TAG_COUNT);
+    tagRemove(tag, bytes);
+}
+
+MemTagStats memTrackStats(MemTag tag)
+{
+    MemTagStats stats;
+    const TagCounters* c = &tagCounters[tag];
+    stats.liveBytes = c->liveBytes.load(std::memory_order_relaxed);
+    stats.peakBytes = c->peakBytes.load(std::memory_order_relaxed);
+    stats.liveCount = c->liveCount.load(std::memory_order_relaxed);
+    stats.totalCount = c->totalCount.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void memTrackLog()
+{
+    for (u32 i = 0; i < MEM_TAG_COUNT; i++)
+    {
+        MemTagStats stats = memTrackStats((MemTag)i);
+        if (stats.totalCount == 0) continue;
+        INFO("Memory %-11s live %llu bytes (%llu allocs), peak %llu bytes, total allocs %llu",
+             tagNames[i], stats.liveBytes, stats.liveCount, stats.peakBytes, stats.totalCount);
+    }
+}
+
+#if MEM_TRACK_DETAILED
+// windows paths in __FILE__ need their backslashes escaped
+static void writeJsonString(FILE* file, const char* str)
+{
+    fputc('"', file);
+    for (const char* c = str; *c; c++)
+    {
+        if (*c == '"' || *c == '\\') fputc('\\', file);
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+#endif
+
+bool memTrackDumpJson(const char* path)
+{
+    FILE* file = NULL;
+#ifdef _MSC_VER
+    fopen_s(&file, path, "w");
+#else
+    file = fopen(path, "w");
+#endif
+    if (!file)
+    {
+        ERROR("Failed to open %s for the memory report", path);
+        return false;
+    }
+
+    fprintf(file, "{\n  \"tags\": {\n");
+    for (u32 i = 0; i < MEM_TAG_COUNT; i++)
+    {
+        MemTagStats stats = memTrackStats((MemTag)i);
+        fprintf(file, "    \"%s\": {\"liveBytes\": %llu, \"peakBytes\": %llu, \"liveCount\": %llu, \"totalCount\": %llu}%s\n",
+                tagNames[i], stats.liveBytes, stats.peakBytes, stats.liveCount, stats.totalCount,
+                i + 1 < MEM_TAG_COUNT ? "," : "");
+    }
+    fprintf(file, "  },\n  \"sites\": [");
+
+#if MEM_TRACK_DETAILED
+    {
+        std::lock_guard<std::mutex> lock(siteMutex);
+        bool first = true;
+        for (u32 i = 0; i < MEM_SITE_CAPACITY; i++)
+        {
+            const CallSite* site = &sites[i];
+            if (!site->file) continue;
+
+            fprintf(file, "%s\n    {\"file\": ", first ? "" : ",");
+            writeJsonString(file, site->file);
+            fprintf(file, ", \"line\": %u, \"tag\": \"%s\", \"liveBytes\": %llu, \"liveCount\": %llu, \"totalBytes\": %llu, \"totalCount\": %llu}",
+                    site->line, tagNames[site->tag], site->liveBytes, site->liveCount, site->totalBytes, site->totalCount);
+            first = false;
+        }
+    }
+    fprintf(file, "\n  ");
+#endif
+    fprintf(file, "]\n}\n");
+
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <druid.h>
+
+
+// Tagged allocation tracking for memory budgets.
+// Every tracked allocation carries a subsystem tag. Per-tag live bytes, peak
+// bytes and allocation counts are always kept with relaxed atomics, which is
+// cheap enough for release builds. With MEM_TRACK_DETAILED (on by default in
+// debug builds) every allocation also records its call site, and the per-site
+// histogram can be written out as JSON.
+#ifndef MEM_TRACK_DETAILED
+#ifdef _DEBUG
+#define MEM_TRACK_DETAILED 1
+#else
+#define MEM_TRACK_DETAILED 0
+#endif
+#endif
+
+typedef enum MemTag
+{
+    MEM_TAG_GENERAL,
+    MEM_TAG_MESH,
+    MEM_TAG_TEXTURE_CPU,
+    MEM_TAG_ECS,
+    MEM_TAG_HASHMAP,
+    MEM_TAG_SCENE,
+    MEM_TAG_TEMP,
+    MEM_TAG_COUNT
+} MemTag;
+
+typedef struct MemTagStats {
+    u64 liveBytes;
+    u64 peakBytes;
+    u64 liveCount;
+    u64 totalCount; // allocations made since startup
+} MemTagStats;
+
+const char* memTagName(MemTag tag);
+
+// malloc/free with a 16 byte header holding the size and tag
+void* memTrackAlloc(u64 size, MemTag tag, const char* file, u32 line);
+void* memTrackCalloc(u64 size, MemTag tag, const char* file, u32 line);
+void memTrackFree(void* ptr);
+
+#define MEM_ALLOC(size, tag) memTrackAlloc((size), (tag), __FILE__, __LINE__)
+#define MEM_CALLOC(size, tag) memTrackCalloc((size), (tag), __FILE__, __LINE__)
+#define MEM_FREE(ptr) memTrackFree(ptr)
+
+// account for memory we don't allocate ourselves (druid arenas, maps, GL staging)
+void memTrackRecord(MemTag tag, u64 bytes, const char* file, u32 line);
+void memTrackRelease(MemTag tag, u64 bytes);
+
+#define MEM_RECORD(tag, bytes) memTrackRecord((tag), (bytes), __FILE__, __LINE__)
+#define MEM_RELEASE(tag, bytes) memTrackRelease((tag), (bytes))
+
+MemTagStats memTrackStats(MemTag tag);
+// one INFO line per tag that has ever been used
+void memTrackLog();
+// writes tag totals and, in detailed mode, the call site histogram
+bool memTrackDumpJson(const char* path);
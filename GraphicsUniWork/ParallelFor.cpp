@@ -0,0 +1,177 @@
+#include "ParallelFor.h"
+#include "MemTrack.h"
+#include "Simd.h"
+
+#define PREFETCH_LINES 2
+
+typedef struct ChunkRange {
+    struct ForEachContext* context;
+    u32 begin; // global chunk indices
+    u32 end;
+} ChunkRange;
+
+typedef struct ForEachContext {
+    Archetype* arch;
+    u64 fieldMask;
+    ChunkFn fn;
+    void* userData;
+    u32 chunkSize;
+    u32 grain;            // ranges this small run serially
+    u32* arenaFirstChunk; // arenaCount + 1 prefix sums
+    ChunkRange* ranges;   // one per submitted job, at most one per chunk
+    std::atomic<u32> rangeCount;
+    JobCounter done;
+} ForEachContext;
+
+static u32 arenaOfChunk(const ForEachContext* context, u32 chunk)
+{
+    // first arena whose range ends after chunk
+    u32 lo = 0;
+    u32 hi = context->arch->arenaCount;
+    while (lo + 1 < hi)
+    {
+        const u32 mid = (lo + hi) / 2;
+        if (context->arenaFirstChunk[mid] <= chunk) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void fillChunk(const ForEachContext* context, u32 chunk, EntityChunk* out)
+{
+    const u32 a = arenaOfChunk(context, chunk);
+    EntityArena* arena = &context->arch->arena[a];
+    const StructLayout* layout = context->arch->layout;
+
+    out->arena = arena;
+    out->arenaIndex = a;
+    out->start = (chunk - context->arenaFirstChunk[a]) * context->chunkSize;
+    out->count = arena->count - out->start;
+    if (out->count > context->chunkSize) out->count = context->chunkSize;
+
+    for (u32 i = 0; i < layout->count; i++)
+    {
+        out->fields[i] = (context->fieldMask >> i) & 1
+            ? (u8*)arena->fields[i] + (u64)out->start * layout->fields[i].size
+            : NULL;
+    }
+}
+
+static void prefetchChunk(const ForEachContext* context, const EntityChunk* chunk)
+{
+    const u32 fieldCount = context->arch->layout->count;
+    for (u32 i = 0; i < fieldCount; i++)
+    {
+        if (!chunk->fields[i]) continue;
+        for (u32 line = 0; line < PREFETCH_LINES; line++)
+            SIMD_PREFETCH((const u8*)chunk->fields[i] + line * 64);
+    }
+}
+
+static void runRange(void* data)
+{
+    ChunkRange* range = (ChunkRange*)data;
+    ForEachContext* context = range->context;
+    u32 begin = range->begin;
+    u32 end = range->end;
+
+    // give away the upper half until what's left is worth running here
+    while (end - begin > context->grain)
+    {
+        const u32 mid = begin + (end - begin) / 2;
+        ChunkRange* upper = &context->ranges[context->rangeCount.fetch_add(1, std::memory_order_relaxed)];
+        upper->context = context;
+        upper->begin = mid;
+        upper->end = end;
+        jobSubmit(runRange, upper, &context->done);
+        end = mid;
+    }
+
+    EntityChunk chunks[2];
+    u32 current = 0;
+    fillChunk(context, begin, &chunks[current]);
+    for (u32 c = begin; c < end; c++)
+    {
+        if (c + 1 < end)
+        {
+            fillChunk(context, c + 1, &chunks[current ^ 1]);
+            prefetchChunk(context, &chunks[current ^ 1]);
+        }
+        context->fn(&chunks[current], context->userData);
+        current ^= 1;
+    }
+}
+
+void forEachChunk(Archetype* arch, u64 fieldMask, ChunkFn fn, u32 chunkSize, void* userData)
+{
+    const StructLayout* layout = arch->layout;
+    if (layout->count > PARALLEL_FOR_MAX_FIELDS)
+    {
+        ERROR("Layout %s has %u fields, chunks hold at most %u", layout->name, layout->count, PARALLEL_FOR_MAX_FIELDS);
+        return;
+    }
+    if (arch->arenaCount == 0) return;
+
+    if (chunkSize == 0)
+    {
+        u32 widest = 1;
+        for (u32 i = 0; i < layout->count; i++)
+        {
+            if (((fieldMask >> i) & 1) && layout->fields[i].size > widest)
+                widest = layout->fields[i].size;
+        }
+        // keep chunks a multiple of 16 entities so SIMD loops have no ragged middle
+        chunkSize = (PARALLEL_FOR_CHUNK_BYTES / widest) & ~15u;
+        if (chunkSize == 0) chunkSize = 16;
+    }
+
+    ForEachContext context;
+    context.arch = arch;
+    context.fieldMask = fieldMask;
+    context.fn = fn;
+    context.userData = userData;
+    context.chunkSize = chunkSize;
+    context.arenaFirstChunk = (u32*)MEM_ALLOC(sizeof(u32) * (arch->arenaCount + 1), MEM_TAG_TEMP);
+    if (!context.arenaFirstChunk)
+    {
+        ERROR("Failed to allocate chunk table");
+        return;
+    }
+
+    u32 chunkCount = 0;
+    for (u32 a = 0; a < arch->arenaCount; a++)
+    {
+        context.arenaFirstChunk[a] = chunkCount;
+        chunkCount += (arch->arena[a].count + chunkSize - 1) / chunkSize;
+    }
+    context.arenaFirstChunk[arch->arenaCount] = chunkCount;
+    if (chunkCount == 0)
+    {
+        MEM_FREE(context.arenaFirstChunk);
+        return;
+    }
+
+    // around eight ranges per thread balances stealing against job overhead
+    context.grain = chunkCount / (jobSystemThreadCount() * 8);
+    if (context.grain == 0) context.grain = 1;
+
+    context.ranges = (ChunkRange*)MEM_ALLOC(sizeof(ChunkRange) * chunkCount, MEM_TAG_TEMP);
+    if (!context.ranges)
+    {
+        ERROR("Failed to allocate chunk ranges");
+        MEM_FREE(context.arenaFirstChunk);
+        return;
+    }
+    context.rangeCount.store(1, std::memory_order_relaxed);
+    context.done.pending.store(0, std::memory_order_relaxed);
+
+    ChunkRange* root = &context.ranges[0];
+    root->context = &context;
+    root->begin = 0;
+    root->end = chunkCount;
+    runRange(root);
+    jobWait(&context.done);
+
+    MEM_FREE(context.ranges);
+    MEM_FREE(context.arenaFirstChunk);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <druid.h>
+#include "JobSystem.h"
+
+
+// Chunked parallel-for over an archetype's SoA arenas.
+// Each arena's live entities are cut into chunks small enough that one
+// chunk of the widest requested field fits in PARALLEL_FOR_CHUNK_BYTES, and
+// the chunks are handed to the job system by recursive halving: a job keeps
+// the lower half of its range and submits the upper half, so idle workers
+// steal the biggest remaining pieces first. Before a chunk runs, the first
+// cache lines of every requested field of the next chunk are prefetched.
+//
+// fieldMask selects which fields the callback gets pointers for (bit i is
+// field i of the layout), the others are NULL in the chunk.
+#define PARALLEL_FOR_CHUNK_BYTES (16 * 1024)
+#define PARALLEL_FOR_ALL_FIELDS (~0ull)
+#define PARALLEL_FOR_MAX_FIELDS 64
+
+typedef struct EntityChunk {
+    EntityArena* arena;
+    u32 arenaIndex;
+    u32 start;  // first entity of the chunk within the arena
+    u32 count;
+    void* fields[PARALLEL_FOR_MAX_FIELDS]; // already offset to start
+} EntityChunk;
+
+typedef void (*ChunkFn)(const EntityChunk* chunk, void* userData);
+
+// chunkSize is in entities, 0 sizes chunks from PARALLEL_FOR_CHUNK_BYTES;
+// returns once every chunk has run
+void forEachChunk(Archetype* arch, u64 fieldMask, ChunkFn fn, u32 chunkSize, void* userData);
@@ -0,0 +1,259 @@
+#include "Pool.h"
+
+#define POOL_ITEM_ALIGN 16u
+
+bool poolCreate(Pool* pool, u32 itemSize, u32 capacity, MemTag tag)
+{
+    memset(pool, 0, sizeof(Pool));
+    if (itemSize == 0 || capacity == 0 || capacity == POOL_INVALID_INDEX)
+    {
+        ERROR("Invalid pool size (item %u, capacity %u)", itemSize, capacity);
+        return false;
+    }
+
+    pool->itemSize = (itemSize + POOL_ITEM_ALIGN - 1) & ~(POOL_ITEM_ALIGN - 1);
+    pool->capacity = capacity;
+    pool->tag = tag;
+
+    pool->data = (u8*)MEM_ALLOC((u64)pool->itemSize * capacity, tag);
+    pool->generations = (u32*)MEM_CALLOC(sizeof(u32) * (u64)capacity, tag);
+    pool->nextFree = (u32*)MEM_ALLOC(sizeof(u32) * (u64)capacity, tag);
+    if (!pool->data || !pool->generations || !pool->nextFree)
+    {
+        ERROR("Failed to allocate pool of %u items", capacity);
+        poolDestroy(pool);
+        return false;
+    }
+
+    poolClear(pool);
+    return true;
+}
+
+void poolDestroy(Pool* pool)
+{
+    MEM_FREE(pool->data);
+    MEM_FREE(pool->generations);
+    MEM_FREE(pool->nextFree);
+    memset(pool, 0, sizeof(Pool));
+}
+
+PoolHandle poolAlloc(Pool* pool)
+{
+    const u32 index = pool->freeHead;
+    if (index == POOL_INVALID_INDEX)
+    {
+        WARN("Pool full (%u items)", pool->capacity);
+        return nullPoolHandle;
+    }
+
+    pool->freeHead = pool->nextFree[index];
+
+    // even -> odd marks the slot alive, skipping 0 when the counter wraps
+    u32 generation = pool->generations[index] + 1;
+    if (generation == 0) generation = 1;
+    pool->generations[index] = generation;
+    pool->count++;
+
+    memset(poolSlot(pool, index), 0, pool->itemSize);
+
+    PoolHandle handle = { index, generation };
+    return handle;
+}
+
+bool poolValid(const Pool* pool, PoolHandle handle)
+{
+    return handle.index < pool->capacity &&
+           handle.generation != 0 &&
+           pool->generations[handle.index] == handle.generation;
+}
+
+bool poolFree(Pool* pool, PoolHandle handle)
+{
+    if (!poolValid(pool, handle))
+        return false;
+
+    pool->generations[handle.index]++;
+    pool->nextFree[handle.index] = pool->freeHead;
+    pool->freeHead = handle.index;
+    pool->count--;
+    return true;
+}
+
+void* poolGet(const Pool* pool, PoolHandle handle)
+{
+    if (!poolValid(pool, handle))
+        return NULL;
+    return poolSlot(pool, handle.index);
+}
+
+void poolClear(Pool* pool)
+{
+    for (u32 i = 0; i < pool->capacity; i++)
+    {
+        // bump live slots to even so their handles go stale
+        if (pool->generations[i] & 1u) pool->generations[i]++;
+        pool->nextFree[i] = i + 1;
+    }
+    pool->nextFree[pool->capacity - 1] = POOL_INVALID_INDEX;
+    pool->freeHead = 0;
+    pool->count = 0;
+}
+
+//=====================================================================================================================
+// colliders
+
+bool colliderPoolCreate(ColliderPool* pool, u32 capacity)
+{
+    return poolCreate(&pool->pool, sizeof(PooledCollider), capacity, MEM_TAG_SCENE);
+}
+
+void colliderPoolDestroy(ColliderPool* pool)
+{
+    poolDestroy(&pool->pool);
+}
+
+static PooledCollider* allocCollider(ColliderPool* pool, ColliderType type, PoolHandle* handle)
+{
+    *handle = poolAlloc(&pool->pool);
+    PooledCollider* col = (PooledCollider*)poolGet(&pool->pool, *handle);
+    if (!col) return NULL;
+
+    col->collider.type = type;
+    col->collider.state = &col->shape;
+    return col;
+}
+
+PoolHandle colliderPoolCircle(ColliderPool* pool, f32 radius)
+{
+    PoolHandle handle;
+    PooledCollider* col = allocCollider(pool, Circle, &handle);
+    if (col) col->shape.radius = radius;
+    return handle;
+}
+
+PoolHandle colliderPoolBox(ColliderPool* pool, Vec2 scale)
+{
+    PoolHandle handle;
+    PooledCollider* col = allocCollider(pool, Box, &handle);
+    if (col) col->shape.boxScale = scale;
+    return handle;
+}
+
+PoolHandle colliderPoolCube(ColliderPool* pool, Vec3 scale)
+{
+    PoolHandle handle;
+    PooledCollider* col = allocCollider(pool, Cube, &handle);
+    if (col) col->shape.cubeScale = scale;
+    return handle;
+}
+
+PoolHandle colliderPoolMesh(ColliderPool* pool, Mesh* mesh, Transform* transform)
+{
+    PoolHandle handle;
+    PooledCollider* col = allocCollider(pool, MeshCollider, &handle);
+    if (col)
+    {
+        col->shape.meshShape.mesh = mesh;
+        col->shape.meshShape.transform = transform;
+    }
+    return handle;
+}
+
+Collider* colliderPoolGet(const ColliderPool* pool, PoolHandle handle)
+{
+    PooledCollider* col = (PooledCollider*)poolGet(&pool->pool, handle);
+    return col ? &col->collider : NULL;
+}
+
+bool colliderPoolRelease(ColliderPool* pool, PoolHandle handle)
+{
+    return poolFree(&pool->pool, handle);
+}
+
+//=====================================================================================================================
+// meshes
+
+bool meshPoolCreate(MeshPool* pool, u32 capacity)
+{
+    return poolCreate(&pool->pool, sizeof(Mesh), capacity, MEM_TAG_MESH);
+}
+
+static void releaseMeshObjects(Mesh* mesh)
+{
+    glDeleteBuffers(NUM_BUFFERS, mesh->vab);
+    glDeleteVertexArrays(1, &mesh->vao);
+    memset(mesh, 0, sizeof(Mesh));
+}
+
+void meshPoolDestroy(MeshPool* pool)
+{
+    for (u32 i = 0; i < pool->pool.capacity; i++)
+    {
+        if (poolSlotAlive(&pool->pool, i))
+            releaseMeshObjects((Mesh*)poolSlot(&pool->pool, i));
+    }
+    poolDestroy(&pool->pool);
+}
+
+PoolHandle meshPoolAdd(MeshPool* pool, const Vertices* vertices, u32 numVertices,
+                       const u32* indices, u32 numIndices)
+{
+    PoolHandle handle = poolAlloc(&pool->pool);
+    Mesh* mesh = (Mesh*)poolGet(&pool->pool, handle);
+    if (!mesh) return nullPoolHandle;
+
+    if (!createMesh(mesh, vertices, numVertices, indices, numIndices))
+    {
+        ERROR("Failed to create pooled mesh");
+        poolFree(&pool->pool, handle);
+        return nullPoolHandle;
+    }
+    return handle;
+}
+
+Mesh* meshPoolGet(const MeshPool* pool, PoolHandle handle)
+{
+    return (Mesh*)poolGet(&pool->pool, handle);
+}
+
+bool meshPoolRelease(MeshPool* pool, PoolHandle handle)
+{
+    Mesh* mesh = (Mesh*)poolGet(&pool->pool, handle);
+    if (!mesh) return false;
+
+    releaseMeshObjects(mesh);
+    return poolFree(&pool->pool, handle);
+}
+
+//=====================================================================================================================
+// materials
+
+bool materialPoolCreate(MaterialPool* pool, u32 capacity)
+{
+    return poolCreate(&pool->pool, sizeof(Material), capacity, MEM_TAG_MESH);
+}
+
+void materialPoolDestroy(MaterialPool* pool)
+{
+    poolDestroy(&pool->pool);
+}
+
+PoolHandle materialPoolAdd(MaterialPool* pool, const Material* material)
+{
+    PoolHandle handle = poolAlloc(&pool->pool);
+    Material* slot = (Material*)poolGet(&pool->pool, handle);
+    if (!slot) return nullPoolHandle;
+
+    *slot = *material;
+    return handle;
+}
+
+Material* materialPoolGet(const MaterialPool* pool, PoolHandle handle)
+{
+    return (Material*)poolGet(&pool->pool, handle);
+}
+
+bool materialPoolRelease(MaterialPool* pool, PoolHandle handle)
+{
+    return poolFree(&pool->pool, handle);
+}
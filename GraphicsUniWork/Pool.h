@@ -0,0 +1,103 @@
+#pragma once
+#include <druid.h>
+#include "MemTrack.h"
+
+
+// Fixed-size object pool. Every slot lives in one contiguous block, free slots
+// are chained through an index free list, so alloc and free are O(1) and live
+// objects stay packed together. Objects are referred to by handles that carry a
+// generation, a handle to a freed (or reused) slot is rejected instead of
+// silently pointing at whatever moved in.
+typedef struct PoolHandle {
+    u32 index;
+    u32 generation; // odd while the slot is alive, 0 is never valid
+} PoolHandle;
+
+#define POOL_INVALID_INDEX 0xFFFFFFFFu
+static const PoolHandle nullPoolHandle = { POOL_INVALID_INDEX, 0 };
+
+typedef struct Pool {
+    u8* data;         // capacity * itemSize bytes
+    u32* generations; // per slot, even = free, odd = alive
+    u32* nextFree;    // free list links
+    u32 itemSize;     // stride, rounded up to 16 bytes
+    u32 capacity;
+    u32 count;        // live objects
+    u32 freeHead;
+    MemTag tag;       // memory tracking tag for the backing storage
+} Pool;
+
+bool poolCreate(Pool* pool, u32 itemSize, u32 capacity, MemTag tag);
+void poolDestroy(Pool* pool);
+
+// returns a zeroed slot, nullPoolHandle when the pool is full
+PoolHandle poolAlloc(Pool* pool);
+// false if the handle is stale or was already freed
+bool poolFree(Pool* pool, PoolHandle handle);
+// NULL if the handle is stale
+void* poolGet(const Pool* pool, PoolHandle handle);
+bool poolValid(const Pool* pool, PoolHandle handle);
+// free every slot at once, all outstanding handles become stale
+void poolClear(Pool* pool);
+
+// slot access for iteration, check poolSlotAlive first
+static inline bool poolSlotAlive(const Pool* pool, u32 index)
+{
+    return (pool->generations[index] & 1u) != 0;
+}
+
+static inline void* poolSlot(const Pool* pool, u32 index)
+{
+    return pool->data + (u64)index * pool->itemSize;
+}
+
+static inline bool poolHandleIsNull(PoolHandle handle)
+{
+    return handle.generation == 0;
+}
+
+//=====================================================================================================================
+// typed pools
+
+// Collider with its shape stored inline, state points at the shape so the
+// collider and its data share a cache line instead of two heap blocks.
+// these never go through cleanCollider, free them with colliderPoolDestroy
+typedef struct PooledCollider {
+    Collider collider;
+    union {
+        f32 radius;     // Circle
+        Vec2 boxScale;  // Box
+        Vec3 cubeScale; // Cube
+        struct {
+            Mesh* mesh;
+            Transform* transform;
+        } meshShape;    // MeshCollider
+    } shape;
+} PooledCollider;
+
+typedef struct ColliderPool { Pool pool; } ColliderPool;
+typedef struct MeshPool { Pool pool; } MeshPool;
+typedef struct MaterialPool { Pool pool; } MaterialPool;
+
+bool colliderPoolCreate(ColliderPool* pool, u32 capacity);
+void colliderPoolDestroy(ColliderPool* pool);
+PoolHandle colliderPoolCircle(ColliderPool* pool, f32 radius);
+PoolHandle colliderPoolBox(ColliderPool* pool, Vec2 scale);
+PoolHandle colliderPoolCube(ColliderPool* pool, Vec3 scale);
+PoolHandle colliderPoolMesh(ColliderPool* pool, Mesh* mesh, Transform* transform);
+Collider* colliderPoolGet(const ColliderPool* pool, PoolHandle handle);
+bool colliderPoolRelease(ColliderPool* pool, PoolHandle handle);
+
+// meshes are built in place with createMesh, releasing deletes the GL objects
+bool meshPoolCreate(MeshPool* pool, u32 capacity);
+void meshPoolDestroy(MeshPool* pool);
+PoolHandle meshPoolAdd(MeshPool* pool, const Vertices* vertices, u32 numVertices,
+                       const u32* indices, u32 numIndices);
+Mesh* meshPoolGet(const MeshPool* pool, PoolHandle handle);
+bool meshPoolRelease(MeshPool* pool, PoolHandle handle);
+
+bool materialPoolCreate(MaterialPool* pool, u32 capacity);
+void materialPoolDestroy(MaterialPool* pool);
+PoolHandle materialPoolAdd(MaterialPool* pool, const Material* material);
+Material* materialPoolGet(const MaterialPool* pool, PoolHandle handle);
+bool materialPoolRelease(MaterialPool* pool, PoolHandle handle);
@@ -0,0 +1,378 @@
+#include "QuatStream.h"
+#include "Simd.h"
+#include <math.h>
+
+#if SIMD_AVX2
+#define QUAT_STREAM_LANES 8
+#else
+#define QUAT_STREAM_LANES 1
+#endif
+
+// above this dot product slerp falls back to nlerp, sin(theta) gets too small
+#define SLERP_NLERP_THRESHOLD 0.9995f
+
+QuatStream quatStream(f32* x, f32* y, f32* z, f32* w, u32 count)
+{
+    QuatStream s = { x, y, z, w, count };
+    return s;
+}
+
+QuatStream quatStreamFromFields(void** fields, u32 xField, u32 count)
+{
+    QuatStream s = { (f32*)fields[xField], (f32*)fields[xField + 1], (f32*)fields[xField + 2],
+                     (f32*)fields[xField + 3], count };
+    return s;
+}
+
+static inline u32 simdEnd(u32 count)
+{
+    return count - (count % QUAT_STREAM_LANES);
+}
+
+//=====================================================================================================================
+// polynomial helpers, the scalar and simd versions use the same coefficients so
+// the tail gives the same answers as the vector lanes
+
+// acos for x in [0,1] (Abramowitz & Stegun 4.4.46, |error| < 2e-8)
+static const f32 acosCoeffs[8] = {
+    1.5707963050f, -0.2145988016f, 0.0889789874f, -0.0501743046f,
+    0.0308918810f, -0.0170881256f, 0.0066700901f, -0.0012624911f
+};
+
+// sin for x in [0, PI/2], taylor to x^11
+static const f32 sinCoeffs[5] = {
+    -1.0f / 6.0f, 1.0f / 120.0f, -1.0f / 5040.0f, 1.0f / 362880.0f, -1.0f / 39916800.0f
+};
+
+static inline f32 acosPoly(f32 x)
+{
+    f32 p = acosCoeffs[7];
+    for (i32 i = 6; i >= 0; i--)
+        p = p * x + acosCoeffs[i];
+    return p * sqrtf(1.0f - x);
+}
+
+static inline f32 sinPoly(f32 x)
+{
+    const f32 x2 = x * x;
+    f32 p = sinCoeffs[4];
+    for (i32 i = 3; i >= 0; i--)
+        p = p * x2 + sinCoeffs[i];
+    return x + x * x2 * p;
+}
+
+#if SIMD_AVX2
+static inline __m256 acosPoly8(__m256 x)
+{
+    __m256 p = _mm256_set1_ps(acosCoeffs[7]);
+    for (i32 i = 6; i >= 0; i--)
+        p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(acosCoeffs[i]));
+    return _mm256_mul_ps(p, _mm256_sqrt_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), x)));
+}
+
+static inline __m256 sinPoly8(__m256 x)
+{
+    const __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_set1_ps(sinCoeffs[4]);
+    for (i32 i = 3; i >= 0; i--)
+        p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(sinCoeffs[i]));
+    return _mm256_fmadd_ps(_mm256_mul_ps(x, x2), p, x);
+}
+
+// 1 / |q|, zero length lanes give 1 so they pass through unchanged
+static inline __m256 invLength8(__m256 x, __m256 y, __m256 z, __m256 w)
+{
+    const __m256 lenSq = _mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_fmadd_ps(z, z, _mm256_mul_ps(w, w))));
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 valid = _mm256_cmp_ps(lenSq, _mm256_setzero_ps(), _CMP_GT_OQ);
+    return _mm256_blendv_ps(one, _mm256_div_ps(one, _mm256_sqrt_ps(lenSq)), valid);
+}
+#endif
+
+static inline f32 invLength(f32 x, f32 y, f32 z, f32 w)
+{
+    const f32 lenSq = x * x + y * y + z * z + w * w;
+    return lenSq > 0.0f ? 1.0f / sqrtf(lenSq) : 1.0f;
+}
+
+//=====================================================================================================================
+
+void quatStreamNormalize(QuatStream* out, const QuatStream* q)
+{
+    const u32 n = out->count;
+    u32 i = 0;
+#if SIMD_AVX2
+    for (; i < simdEnd(n); i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(q->x + i), y = _mm256_loadu_ps(q->y + i);
+        const __m256 z = _mm256_loadu_ps(q->z + i), w = _mm256_loadu_ps(q->w + i);
+        const __m256 inv = invLength8(x, y, z, w);
+        _mm256_storeu_ps(out->x + i, _mm256_mul_ps(x, inv));
+        _mm256_storeu_ps(out->y + i, _mm256_mul_ps(y, inv));
+        _mm256_storeu_ps(out->z + i, _mm256_mul_ps(z, inv));
+        _mm256_storeu_ps(out->w + i, _mm256_mul_ps(w, inv));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        const f32 x = q->x[i], y = q->y[i], z = q->z[i], w = q->w[i];
+        const f32 inv = invLength(x, y, z, w);
+        out->x[i] = x * inv;
+        out->y[i] = y * inv;
+        out->z[i] = z * inv;
+        out->w[i] = w * inv;
+    }
+}
+
+void quatStreamMul(QuatStream* out, const QuatStream* a, const QuatStream* b)
+{
+    const u32 n = out->count;
+    u32 i = 0;
+#if SIMD_AVX2
+    for (; i < simdEnd(n); i += 8)
+    {
+        const __m256 ax = _mm256_loadu_ps(a->x + i), ay = _mm256_loadu_ps(a->y + i);
+        const __m256 az = _mm256_loadu_ps(a->z + i), aw = _mm256_loadu_ps(a->w + i);
+        const __m256 bx = _mm256_loadu_ps(b->x + i), by = _mm256_loadu_ps(b->y + i);
+        const __m256 bz = _mm256_loadu_ps(b->z + i), bw = _mm256_loadu_ps(b->w + i);
+
+        __m256 x = _mm256_mul_ps(aw, bx);
+        x = _mm256_fmadd_ps(ax, bw, x);
+        x = _mm256_fmadd_ps(ay, bz, x);
+        x = _mm256_fnmadd_ps(az, by, x);
+
+        __m256 y = _mm256_mul_ps(aw, by);
+        y = _mm256_fnmadd_ps(ax, bz, y);
+        y = _mm256_fmadd_ps(ay, bw, y);
+        y = _mm256_fmadd_ps(az, bx, y);
+
+        __m256 z = _mm256_mul_ps(aw, bz);
+        z = _mm256_fmadd_ps(ax, by, z);
+        z = _mm256_fnmadd_ps(ay, bx, z);
+        z = _mm256_fmadd_ps(az, bw, z);
+
+        __m256 w = _mm256_mul_ps(aw, bw);
+        w = _mm256_fnmadd_ps(ax, bx, w);
+        w = _mm256_fnmadd_ps(ay, by, w);
+        w = _mm256_fnmadd_ps(az, bz, w);
+
+        _mm256_storeu_ps(out->x + i, x);
+        _mm256_storeu_ps(out->y + i, y);
+        _mm256_storeu_ps(out->z + i, z);
+        _mm256_storeu_ps(out->w + i, w);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        const f32 ax = a->x[i], ay = a->y[i], az = a->z[i], aw = a->w[i];
+        const f32 bx = b->x[i], by = b->y[i], bz = b->z[i], bw = b->w[i];
+        out->x[i] = aw * bx + ax * bw + ay * bz - az * by;
+        out->y[i] = aw * by - ax * bz + ay * bw + az * bx;
+        out->z[i] = aw * bz + ax * by - ay * bx + az * bw;
+        out->w[i] = aw * bw - ax * bx - ay * by - az * bz;
+    }
+}
+
+void quatStreamNlerp(QuatStream* out, const QuatStream* a, const QuatStream* b, f32 t)
+{
+    const u32 n = out->count;
+    u32 i = 0;
+#if SIMD_AVX2
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+    const __m256 wa = _mm256_set1_ps(1.0f - t);
+    const __m256 wb = _mm256_set1_ps(t);
+    for (; i < simdEnd(n); i += 8)
+    {
+        const __m256 ax = _mm256_loadu_ps(a->x + i), ay = _mm256_loadu_ps(a->y + i);
+        const __m256 az = _mm256_loadu_ps(a->z + i), aw = _mm256_loadu_ps(a->w + i);
+        __m256 bx = _mm256_loadu_ps(b->x + i), by = _mm256_loadu_ps(b->y + i);
+        __m256 bz = _mm256_loadu_ps(b->z + i), bw = _mm256_loadu_ps(b->w + i);
+
+        // flip b onto the same hemisphere as a for the short arc
+        const __m256 d = _mm256_fmadd_ps(ax, bx, _mm256_fmadd_ps(ay, by, _mm256_fmadd_ps(az, bz, _mm256_mul_ps(aw, bw))));
+        const __m256 sign = _mm256_and_ps(d, signBit);
+        bx = _mm256_xor_ps(bx, sign);
+        by = _mm256_xor_ps(by, sign);
+        bz = _mm256_xor_ps(bz, sign);
+        bw = _mm256_xor_ps(bw, sign);
+
+        const __m256 x = _mm256_fmadd_ps(ax, wa, _mm256_mul_ps(bx, wb));
+        const __m256 y = _mm256_fmadd_ps(ay, wa, _mm256_mul_ps(by, wb));
+        const __m256 z = _mm256_fmadd_ps(az, wa, _mm256_mul_ps(bz, wb));
+        const __m256 w = _mm256_fmadd_ps(aw, wa, _mm256_mul_ps(bw, wb));
+        const __m256 inv = invLength8(x, y, z, w);
+        _mm256_storeu_ps(out->x + i, _mm256_mul_ps(x, inv));
+        _mm256_storeu_ps(out->y + i, _mm256_mul_ps(y, inv));
+        _mm256_storeu_ps(out->z + i, _mm256_mul_ps(z, inv));
+        _mm256_storeu_ps(out->w + i, _mm256_mul_ps(w, inv));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        const f32 ax = a->x[i], ay = a->y[i], az = a->z[i], aw = a->w[i];
+        f32 bx = b->x[i], by = b->y[i], bz = b->z[i], bw = b->w[i];
+        if (ax * bx + ay * by + az * bz + aw * bw < 0.0f)
+        {
+            bx = -bx; by = -by; bz = -bz; bw = -bw;
+        }
+        const f32 x = ax * (1.0f - t) + bx * t;
+        const f32 y = ay * (1.0f - t) + by * t;
+        const f32 z = az * (1.0f - t) + bz * t;
+        const f32 w = aw * (1.0f - t) + bw * t;
+        const f32 inv = invLength(x, y, z, w);
+        out->x[i] = x * inv;
+        out->y[i] = y * inv;
+        out->z[i] = z * inv;
+        out->w[i] = w * inv;
+    }
+}
+
+void quatStreamSlerp(QuatStream* out, const QuatStream* a, const QuatStream* b, f32 t)
+{
+    const u32 n = out->count;
+    u32 i = 0;
+#if SIMD_AVX2
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 tv = _mm256_set1_ps(t);
+    const __m256 oneMinusT = _mm256_set1_ps(1.0f - t);
+    const __m256 threshold = _mm256_set1_ps(SLERP_NLERP_THRESHOLD);
+    for (; i < simdEnd(n); i += 8)
+    {
+        const __m256 ax = _mm256_loadu_ps(a->x + i), ay = _mm256_loadu_ps(a->y + i);
+        const __m256 az = _mm256_loadu_ps(a->z + i), aw = _mm256_loadu_ps(a->w + i);
+        __m256 bx = _mm256_loadu_ps(b->x + i), by = _mm256_loadu_ps(b->y + i);
+        __m256 bz = _mm256_loadu_ps(b->z + i), bw = _mm256_loadu_ps(b->w + i);
+
+        __m256 d = _mm256_fmadd_ps(ax, bx, _mm256_fmadd_ps(ay, by, _mm256_fmadd_ps(az, bz, _mm256_mul_ps(aw, bw))));
+        const __m256 sign = _mm256_and_ps(d, signBit);
+        bx = _mm256_xor_ps(bx, sign);
+        by = _mm256_xor_ps(by, sign);
+        bz = _mm256_xor_ps(bz, sign);
+        bw = _mm256_xor_ps(bw, sign);
+        d = _mm256_min_ps(_mm256_andnot_ps(signBit, d), one);
+
+        // theta is in [0, PI/2] once b is on a's hemisphere
+        const __m256 theta = acosPoly8(d);
+        const __m256 invSinTheta = _mm256_div_ps(one, sinPoly8(theta));
+        __m256 wa = _mm256_mul_ps(sinPoly8(_mm256_mul_ps(oneMinusT, theta)), invSinTheta);
+        __m256 wb = _mm256_mul_ps(sinPoly8(_mm256_mul_ps(tv, theta)), invSinTheta);
+
+        // nearly parallel lanes use the linear weights
+        const __m256 nearlyParallel = _mm256_cmp_ps(d, threshold, _CMP_GT_OQ);
+        wa = _mm256_blendv_ps(wa, oneMinusT, nearlyParallel);
+        wb = _mm256_blendv_ps(wb, tv, nearlyParallel);
+
+        const __m256 x = _mm256_fmadd_ps(ax, wa, _mm256_mul_ps(bx, wb));
+        const __m256 y = _mm256_fmadd_ps(ay, wa, _mm256_mul_ps(by, wb));
+        const __m256 z = _mm256_fmadd_ps(az, wa, _mm256_mul_ps(bz, wb));
+        const __m256 w = _mm256_fmadd_ps(aw, wa, _mm256_mul_ps(bw, wb));
+        const __m256 inv = invLength8(x, y, z, w);
+        _mm256_storeu_ps(out->x + i, _mm256_mul_ps(x, inv));
+        _mm256_storeu_ps(out->y + i, _mm256_mul_ps(y, inv));
+        _mm256_storeu_ps(out->z + i, _mm256_mul_ps(z, inv));
+        _mm256_storeu_ps(out->w + i, _mm256_mul_ps(w, inv));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        const f32 ax = a->x[i], ay = a->y[i], az = a->z[i], aw = a->w[i];
+        f32 bx = b->x[i], by = b->y[i], bz = b->z[i], bw = b->w[i];
+        f32 d = ax * bx + ay * by + az * bz + aw * bw;
+        if (d < 0.0f)
+        {
+            bx = -bx; by = -by; bz = -bz; bw = -bw;
+            d = -d;
+        }
+        if (d > 1.0f) d = 1.0f;
+
+        f32 wa = 1.0f - t;
+        f32 wb = t;
+        if (d <= SLERP_NLERP_THRESHOLD)
+        {
+            const f32 theta = acosPoly(d);
+            const f32 invSinTheta = 1.0f / sinPoly(theta);
+            wa = sinPoly((1.0f - t) * theta) * invSinTheta;
+            wb = sinPoly(t * theta) * invSinTheta;
+        }
+
+        const f32 x = ax * wa + bx * wb;
+        const f32 y = ay * wa + by * wb;
+        const f32 z = az * wa + bz * wb;
+        const f32 w = aw * wa + bw * wb;
+        const f32 inv = invLength(x, y, z, w);
+        out->x[i] = x * inv;
+        out->y[i] = y * inv;
+        out->z[i] = z * inv;
+        out->w[i] = w * inv;
+    }
+}
+
+void quatStreamIntegrate(QuatStream* q, const Vec3Stream* omega, f32 dt)
+{
+    const u32 n = q->count;
+    const f32 h = 0.5f * dt;
+    u32 i = 0;
+#if SIMD_AVX2
+    const __m256 hv = _mm256_set1_ps(h);
+    for (; i < simdEnd(n); i += 8)
+    {
+        const __m256 qx = _mm256_loadu_ps(q->x + i), qy = _mm256_loadu_ps(q->y + i);
+        const __m256 qz = _mm256_loadu_ps(q->z + i), qw = _mm256_loadu_ps(q->w + i);
+        const __m256 ox = _mm256_loadu_ps(omega->x + i), oy = _mm256_loadu_ps(omega->y + i);
+        const __m256 oz = _mm256_loadu_ps(omega->z + i);
+
+        // (omega, 0) * q, w is -dot(omega, q.xyz)
+        const __m256 dx = _mm256_fmsub_ps(ox, qw, _mm256_fmsub_ps(oz, qy, _mm256_mul_ps(oy, qz)));
+        const __m256 dy = _mm256_fmsub_ps(oy, qw, _mm256_fmsub_ps(ox, qz, _mm256_mul_ps(oz, qx)));
+        const __m256 dz = _mm256_fmsub_ps(oz, qw, _mm256_fmsub_ps(oy, qx, _mm256_mul_ps(ox, qy)));
+        const __m256 dot = _mm256_fmadd_ps(ox, qx, _mm256_fmadd_ps(oy, qy, _mm256_mul_ps(oz, qz)));
+
+        const __m256 x = _mm256_fmadd_ps(dx, hv, qx);
+        const __m256 y = _mm256_fmadd_ps(dy, hv, qy);
+        const __m256 z = _mm256_fmadd_ps(dz, hv, qz);
+        const __m256 w = _mm256_fnmadd_ps(dot, hv, qw);
+        const __m256 inv = invLength8(x, y, z, w);
+        _mm256_storeu_ps(q->x + i, _mm256_mul_ps(x, inv));
+        _mm256_storeu_ps(q->y + i, _mm256_mul_ps(y, inv));
+        _mm256_storeu_ps(q->z + i, _mm256_mul_ps(z, inv));
+        _mm256_storeu_ps(q->w + i, _mm256_mul_ps(w, inv));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        const f32 qx = q->x[i], qy = q->y[i], qz = q->z[i], qw = q->w[i];
+        const f32 ox = omega->x[i], oy = omega->y[i], oz = omega->z[i];
+        const f32 x = qx + h * (ox * qw + oy * qz - oz * qy);
+        const f32 y = qy + h * (oy * qw + oz * qx - ox * qz);
+        const f32 z = qz + h * (oz * qw + ox * qy - oy * qx);
+        const f32 w = qw - h * (ox * qx + oy * qy + oz * qz);
+        const f32 inv = invLength(x, y, z, w);
+        q->x[i] = x * inv;
+        q->y[i] = y * inv;
+        q->z[i] = z * inv;
+        q->w[i] = w * inv;
+    }
+}
+
+void quatStreamLoad(QuatStream* out, const Vec4* in)
+{
+    for (u32 i = 0; i < out->count; i++)
+    {
+        out->x[i] = in[i].x;
+        out->y[i] = in[i].y;
+        out->z[i] = in[i].z;
+        out->w[i] = in[i].w;
+    }
+}
+
+void quatStreamStore(const QuatStream* in, Vec4* out)
+{
+    for (u32 i = 0; i < in->count; i++)
+    {
+        out[i].x = in->x[i];
+        out[i].y = in->y[i];
+        out[i].z = in->z[i];
+        out[i].w = in->w[i];
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <druid.h>
+#include "Vec3Stream.h"
+
+
+// SoA view over four float columns holding quaternions (x, y, z, w), e.g. the
+// fields VEC4_FIELDS(rot) expands to. Same rules as Vec3Stream: kernels run
+// 8 lanes at a time with AVX2, any count is valid and outputs may alias inputs.
+typedef struct QuatStream {
+    f32* x;
+    f32* y;
+    f32* z;
+    f32* w;
+    u32 count;
+} QuatStream;
+
+QuatStream quatStream(f32* x, f32* y, f32* z, f32* w, u32 count);
+// view over consecutive X/Y/Z/W soa fields starting at xField
+QuatStream quatStreamFromFields(void** fields, u32 xField, u32 count);
+
+// the kernels process out->count elements, inputs must be at least as long
+void quatStreamNormalize(QuatStream* out, const QuatStream* q);
+// out = a * b, same order as quatMul
+void quatStreamMul(QuatStream* out, const QuatStream* a, const QuatStream* b);
+
+// interpolation along the shortest arc, t in [0,1]
+void quatStreamNlerp(QuatStream* out, const QuatStream* a, const QuatStream* b, f32 t);
+// constant angular velocity, max error against a double reference is ~1e-6
+void quatStreamSlerp(QuatStream* out, const QuatStream* a, const QuatStream* b, f32 t);
+
+// q += 0.5 * dt * (omega * q), then renormalise. omega is a world space
+// angular velocity in radians per second
+void quatStreamIntegrate(QuatStream* q, const Vec3Stream* omega, f32 dt);
+
+void quatStreamLoad(QuatStream* out, const Vec4* in);
+void quatStreamStore(const QuatStream* in, Vec4* out);
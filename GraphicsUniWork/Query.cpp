@@ -0,0 +1,270 @@
+#include "Query.h"
+#include "MemTrack.h"
+#include "ParallelFor.h"
+
+#define NO_TERM 0xFFu
+
+static bool registerQuery(ArchetypeGraph* graph, Query* query)
+{
+    if (graph->queryCount == graph->queryCapacity)
+    {
+        const u32 capacity = graph->queryCapacity ? graph->queryCapacity * 2 : 16;
+        Query** grown = (Query**)MEM_ALLOC(sizeof(Query*) * capacity, MEM_TAG_ECS);
+        if (!grown)
+        {
+            ERROR("Failed to register query");
+            return false;
+        }
+        if (graph->queries)
+        {
+            memcpy(grown, graph->queries, sizeof(Query*) * graph->queryCount);
+            MEM_FREE(graph->queries);
+        }
+        graph->queries = grown;
+        graph->queryCapacity = capacity;
+    }
+    graph->queries[graph->queryCount++] = query;
+    return true;
+}
+
+bool queryCreate(Query* query, ArchetypeGraph* graph, const QueryDesc* desc)
+{
+    memset(query, 0, sizeof(Query));
+    query->graph = graph;
+    query->with = desc->with;
+    query->without = desc->without;
+    query->optional = desc->optional & ~desc->with;
+    query->changed = desc->changed & (query->with | query->optional);
+    if (query->with & query->without)
+        WARN("Query requires and excludes the same components, it will never match");
+    if (query->changed != desc->changed)
+        WARN("Query change filter names components it doesn't read, they are ignored");
+
+    memset(query->termOfComponent, NO_TERM, sizeof(query->termOfComponent));
+    const ComponentMask terms = query->with | query->optional;
+    for (ComponentId c = 0; c < ECS_MAX_COMPONENTS; c++)
+    {
+        if (terms & componentBit(c))
+            query->termOfComponent[c] = (u8)query->termCount++;
+    }
+
+    if (!registerQuery(graph, query))
+        return false;
+
+    for (u32 node = 0; node < graph->nodeCount; node++)
+        queryMatchNode(query, node);
+    return true;
+}
+
+void queryDestroy(Query* query)
+{
+    ArchetypeGraph* graph = query->graph;
+    for (u32 i = 0; graph && i < graph->queryCount; i++)
+    {
+        if (graph->queries[i] == query)
+        {
+            graph->queries[i] = graph->queries[--graph->queryCount];
+            break;
+        }
+    }
+    MEM_FREE(query->matches);
+    memset(query, 0, sizeof(Query));
+}
+
+void queryMatchNode(Query* query, u32 node)
+{
+    const ArchetypeNode* n = query->graph->nodes[node];
+    if ((n->mask & query->with) != query->with || (n->mask & query->without) != 0)
+        return;
+
+    if (query->matchCount == query->matchCapacity)
+    {
+        const u32 capacity = query->matchCapacity ? query->matchCapacity * 2 : 16;
+        QueryMatch* grown = (QueryMatch*)MEM_ALLOC(sizeof(QueryMatch) * capacity, MEM_TAG_ECS);
+        if (!grown)
+        {
+            ERROR("Failed to grow query matches");
+            return;
+        }
+        if (query->matches)
+        {
+            memcpy(grown, query->matches, sizeof(QueryMatch) * query->matchCount);
+            MEM_FREE(query->matches);
+        }
+        query->matches = grown;
+        query->matchCapacity = capacity;
+    }
+
+    QueryMatch* match = &query->matches[query->matchCount++];
+    match->node = node;
+    match->changedFields = 0;
+    for (ComponentId c = 0; c < ECS_MAX_COMPONENTS; c++)
+    {
+        const u8 term = query->termOfComponent[c];
+        if (term != NO_TERM)
+            match->fieldOfTerm[term] = n->fieldOfComponent[c];
+        if ((query->changed & componentBit(c)) && n->fieldOfComponent[c] != NO_TERM)
+            match->changedFields |= 1ull << n->fieldOfComponent[c];
+    }
+}
+
+u32 queryEntityCount(const Query* query)
+{
+    u32 count = 0;
+    for (u32 m = 0; m < query->matchCount; m++)
+    {
+        const Archetype* arch = query->graph->nodes[query->matches[m].node]->arch;
+        for (u32 a = 0; a < arch->arenaCount; a++)
+            count += arch->arena[a].count;
+    }
+    return count;
+}
+
+static void fillColumns(const Query* query, const QueryMatch* match, void* const* fields,
+                        const StructLayout* layout, u32 start, QueryChunk* out)
+{
+    for (u32 t = 0; t < query->termCount; t++)
+    {
+        const u8 field = match->fieldOfTerm[t];
+        out->columns[t] = field == NO_TERM
+            ? NULL
+            : (u8*)fields[field] + (u64)start * layout->fields[field].size;
+    }
+}
+
+static void emitRun(const Query* query, const QueryMatch* match, QueryChunk* chunk,
+                    u32 start, u32 count, QueryFn fn, void* userData)
+{
+    chunk->start = start;
+    chunk->count = count;
+    fillColumns(query, match, chunk->arena->fields, chunk->arch->layout, start, chunk);
+    fn(chunk, userData);
+}
+
+// calls fn on [start, start + count), minus the change chunks nobody wrote
+// since the given version; neighbouring changed chunks are merged into one call
+static void runRange(const Query* query, const QueryMatch* match, QueryChunk* chunk,
+                     u32 start, u32 count, u32 since, QueryFn fn, void* userData)
+{
+    if (!query->changed || !chunk->table)
+    {
+        emitRun(query, match, chunk, start, count, fn, userData);
+        return;
+    }
+
+    const u32 end = start + count;
+    u32 runStart = start;
+    u32 runEnd = start;
+    for (u32 begin = start; begin < end;)
+    {
+        u32 next = ((begin >> ENTITY_CHANGE_CHUNK_SHIFT) + 1) << ENTITY_CHANGE_CHUNK_SHIFT;
+        if (next > end) next = end;
+
+        bool changed = false;
+        for (u32 f = 0; f < chunk->arch->layout->count && !changed; f++)
+        {
+            if (match->changedFields & (1ull << f))
+                changed = entityChangedVersion(chunk->table, chunk->arenaIndex, f, begin, next - begin) > since;
+        }
+        if (changed)
+        {
+            if (runEnd != begin)
+            {
+                if (runEnd > runStart)
+                    emitRun(query, match, chunk, runStart, runEnd - runStart, fn, userData);
+                runStart = begin;
+            }
+            runEnd = next;
+        }
+        begin = next;
+    }
+    if (runEnd > runStart)
+        emitRun(query, match, chunk, runStart, runEnd - runStart, fn, userData);
+}
+
+// the run's own version stamps its writes, later runs look past it
+static u32 beginRun(Query* query, u32* since)
+{
+    *since = query->lastRunVersion;
+    const u32 version = query->graph->registry->changeVersion.fetch_add(1, std::memory_order_relaxed);
+    query->lastRunVersion = version;
+    return version;
+}
+
+static void beginMatch(const Query* query, const QueryMatch* match, u32 version, QueryChunk* chunk)
+{
+    Archetype* arch = query->graph->nodes[match->node]->arch;
+    chunk->arch = arch;
+    chunk->table = entityRegistryTable(query->graph->registry, arch->id);
+    chunk->version = version;
+    chunk->fieldOfTerm = match->fieldOfTerm;
+}
+
+void queryForEach(Query* query, QueryFn fn, void* userData)
+{
+    u32 since;
+    const u32 version = beginRun(query, &since);
+
+    QueryChunk chunk;
+    for (u32 m = 0; m < query->matchCount; m++)
+    {
+        const QueryMatch* match = &query->matches[m];
+        beginMatch(query, match, version, &chunk);
+        for (u32 a = 0; a < chunk.arch->arenaCount; a++)
+        {
+            EntityArena* arena = &chunk.arch->arena[a];
+            if (arena->count == 0) continue;
+
+            chunk.arena = arena;
+            chunk.arenaIndex = a;
+            runRange(query, match, &chunk, 0, arena->count, since, fn, userData);
+        }
+    }
+}
+
+typedef struct ParallelQuery {
+    const Query* query;
+    const QueryMatch* match;
+    u32 since;
+    u32 version;
+    QueryFn fn;
+    void* userData;
+} ParallelQuery;
+
+// forEachChunk hands out fields by layout index, the query wants them by term
+static void runQueryChunk(const EntityChunk* entityChunk, void* data)
+{
+    const ParallelQuery* pq = (const ParallelQuery*)data;
+
+    QueryChunk chunk;
+    beginMatch(pq->query, pq->match, pq->version, &chunk);
+    chunk.arena = entityChunk->arena;
+    chunk.arenaIndex = entityChunk->arenaIndex;
+    runRange(pq->query, pq->match, &chunk, entityChunk->start, entityChunk->count, pq->since, pq->fn, pq->userData);
+}
+
+void queryForEachParallel(Query* query, QueryFn fn, u32 chunkSize, void* userData)
+{
+    // jobs must not share a change chunk, or queryColumnWrite stamps race
+    if (chunkSize == 0) chunkSize = 4 * ENTITY_CHANGE_CHUNK;
+    chunkSize = (chunkSize + ENTITY_CHANGE_CHUNK - 1) & ~(ENTITY_CHANGE_CHUNK - 1);
+
+    u32 since;
+    const u32 version = beginRun(query, &since);
+
+    for (u32 m = 0; m < query->matchCount; m++)
+    {
+        const QueryMatch* match = &query->matches[m];
+        const ArchetypeNode* node = query->graph->nodes[match->node];
+
+        u64 fieldMask = 0;
+        for (u32 t = 0; t < query->termCount; t++)
+        {
+            if (match->fieldOfTerm[t] != NO_TERM)
+                fieldMask |= 1ull << match->fieldOfTerm[t];
+        }
+
+        ParallelQuery pq = { query, match, since, version, fn, userData };
+        forEachChunk(node->arch, fieldMask, runQueryChunk, chunkSize, &pq);
+    }
+}
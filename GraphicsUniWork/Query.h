@@ -0,0 +1,97 @@
+#pragma once
+#include <druid.h>
+#include "ArchetypeGraph.h"
+
+
+// Cached ECS queries over an archetype graph.
+// A query names components an archetype must have (with), must not have
+// (without) and may have (optional). Matching runs once per archetype:
+// against every existing node when the query is created, then against each
+// new node as the graph adds it, so a query never rescans the graph.
+// Iterating is a flat loop over the matched archetypes' arenas with the
+// columns already resolved.
+//
+// Columns are handed out in term order, the with and optional components
+// sorted by component id; queryTerm gives a component's slot. A missing
+// optional component's column is NULL.
+//
+// A query with a changed mask only visits rows whose chunk of any of those
+// components was written since the query's previous run (see the change
+// versions in EntityHandle.h); the first run visits everything. Each run
+// takes its own version from the registry, and columns fetched with
+// queryColumnWrite are stamped with it. A query's own writes therefore don't
+// wake it up again, while everyone else's do.
+typedef struct QueryDesc {
+    ComponentMask with;
+    ComponentMask without;
+    ComponentMask optional;
+    ComponentMask changed; // with or optional components, 0 visits every row
+} QueryDesc;
+
+typedef struct QueryMatch {
+    u32 node;
+    u64 changedFields;                  // layout fields the change filter looks at
+    u8 fieldOfTerm[ECS_MAX_COMPONENTS]; // layout field index, 0xFF for a missing optional
+} QueryMatch;
+
+typedef struct Query {
+    ArchetypeGraph* graph;
+    ComponentMask with;
+    ComponentMask without;
+    ComponentMask optional;
+    ComponentMask changed;
+    u32 lastRunVersion; // 0 until the first run
+    u32 termCount;
+    u8 termOfComponent[ECS_MAX_COMPONENTS]; // 0xFF when the component isn't a term
+    QueryMatch* matches;
+    u32 matchCount;
+    u32 matchCapacity;
+} Query;
+
+typedef struct QueryChunk {
+    Archetype* arch;
+    EntityArena* arena;
+    EntityTable* table;
+    u32 arenaIndex;
+    u32 start;  // first entity within the arena
+    u32 count;
+    u32 version; // of the run, stamped by queryColumnWrite
+    const u8* fieldOfTerm;
+    void* columns[ECS_MAX_COMPONENTS]; // by term, offset to start
+} QueryChunk;
+
+typedef void (*QueryFn)(const QueryChunk* chunk, void* userData);
+
+// the query registers with the graph and must be destroyed before it
+bool queryCreate(Query* query, ArchetypeGraph* graph, const QueryDesc* desc);
+void queryDestroy(Query* query);
+
+// called by the graph for every node it adds
+void queryMatchNode(Query* query, u32 node);
+
+static inline u32 queryTerm(const Query* query, ComponentId component)
+{
+    return query->termOfComponent[component];
+}
+
+static inline void* queryColumn(const QueryChunk* chunk, u32 term)
+{
+    return chunk->columns[term];
+}
+
+// the column for writing: marks the chunk's rows changed for other queries
+static inline void* queryColumnWrite(const QueryChunk* chunk, u32 term)
+{
+    const u8 field = chunk->fieldOfTerm[term];
+    if (field != 0xFF && chunk->table)
+        entityMarkChanged(chunk->table, chunk->arenaIndex, field, chunk->start, chunk->count, chunk->version);
+    return chunk->columns[term];
+}
+
+u32 queryEntityCount(const Query* query);
+// one call per non-empty arena of every matched archetype, or per run of
+// changed chunks when the query has a changed mask
+void queryForEach(Query* query, QueryFn fn, void* userData);
+// chunked across the job system with forEachChunk; chunkSize is rounded up to
+// whole change chunks, 0 picks 4 of them
+void queryForEachParallel(Query* query, QueryFn fn, u32 chunkSize, void* userData);
@@ -0,0 +1,550 @@
+#include "ResourceIndex.h"
+#include "MemTrack.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#if PLATFORM_WINDOWS
+// NOGDI keeps wingdi.h from redefining druid's ERROR log macro
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define NOGDI
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// average keys per bucket, higher makes the index smaller and the bake slower
+#define KEYS_PER_BUCKET 5
+#define MAX_DISPLACEMENT (1u << 24)
+#define MAX_RESOURCE_PATH 512
+
+static inline u64 mix64(u64 x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+// multiply-shift maps a 32 bit hash onto [0, range) without a divide
+static inline u32 fastRange(u64 h, u32 range)
+{
+    return (u32)(((h >> 32) * (u64)range) >> 32);
+}
+
+static inline u32 bucketOf(StringId id, u32 bucketCount)
+{
+    return fastRange(mix64(id), bucketCount);
+}
+
+static inline u32 slotOf(StringId id, u32 displacement, u32 count)
+{
+    return fastRange(mix64(id ^ (0x9E3779B97F4A7C15ull * (displacement + 1))), count);
+}
+
+//=====================================================================================================================
+// runtime
+
+const ResourceIndexEntry* resourceIndexFind(const ResourceIndex* index, StringId id)
+{
+    const ResourceIndexHeader* header = index->header;
+    if (!header || header->count == 0) return NULL;
+
+    const u32 displacement = index->displacements[bucketOf(id, header->bucketCount)];
+    const ResourceIndexEntry* entry = &index->entries[slotOf(id, displacement, header->count)];
+    // names that were never baked still land on some slot, the stored ID rejects them
+    return entry->id == id ? entry : NULL;
+}
+
+const char* resourceIndexPath(const ResourceIndex* index, const ResourceIndexEntry* entry)
+{
+    return index->paths + entry->pathOffset;
+}
+
+static bool validateIndex(ResourceIndex* index)
+{
+    if (index->size < sizeof(ResourceIndexHeader)) return false;
+
+    const ResourceIndexHeader* header = (const ResourceIndexHeader*)index->data;
+    if (header->magic != RESOURCE_INDEX_MAGIC || header->version != RESOURCE_INDEX_VERSION) return false;
+    if (header->fileSize != index->size || header->bucketCount == 0) return false;
+    if (header->displacementOffset + (u64)header->bucketCount * sizeof(u32) > header->entriesOffset) return false;
+    if (header->entriesOffset % alignof(ResourceIndexEntry) != 0) return false;
+    if (header->entriesOffset + (u64)header->count * sizeof(ResourceIndexEntry) > header->pathsOffset) return false;
+    if (header->pathsOffset > index->size) return false;
+
+    index->header = header;
+    index->displacements = (const u32*)(index->data + header->displacementOffset);
+    index->entries = (const ResourceIndexEntry*)(index->data + header->entriesOffset);
+    index->paths = (const char*)(index->data + header->pathsOffset);
+
+    const u64 pathsSize = index->size - header->pathsOffset;
+    for (u32 i = 0; i < header->count; i++)
+    {
+        const ResourceIndexEntry* entry = &index->entries[i];
+        if (entry->pathOffset + (u64)entry->pathLength >= pathsSize || entry->kind >= RESOURCE_KIND_COUNT)
+            return false;
+    }
+    return true;
+}
+
+bool resourceIndexOpen(ResourceIndex* index, const char* path)
+{
+    memset(index, 0, sizeof(ResourceIndex));
+
+#if PLATFORM_WINDOWS
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    index->data = (const u8*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    index->size = (u64)size.QuadPart;
+    index->mapping = mapping;
+    index->file = file;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    void* mapped = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+        mapped = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file contents alive on its own
+    close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    index->data = (const u8*)mapped;
+    index->size = (u64)info.st_size;
+#endif
+
+    if (!index->data || !validateIndex(index))
+    {
+        ERROR("Resource index %s is invalid or out of date, rebake it", path);
+        resourceIndexClose(index);
+        return false;
+    }
+    return true;
+}
+
+void resourceIndexClose(ResourceIndex* index)
+{
+#if PLATFORM_WINDOWS
+    if (index->data) UnmapViewOfFile(index->data);
+    if (index->mapping) CloseHandle((HANDLE)index->mapping);
+    if (index->file) CloseHandle((HANDLE)index->file);
+#else
+    if (index->data) munmap((void*)index->data, (size_t)index->size);
+#endif
+    memset(index, 0, sizeof(ResourceIndex));
+}
+
+//=====================================================================================================================
+// offline bake
+
+typedef struct BucketOrder {
+    u32 bucket;
+    u32 size;
+} BucketOrder;
+
+static int compareBucketSize(const void* a, const void* b)
+{
+    const BucketOrder* x = (const BucketOrder*)a;
+    const BucketOrder* y = (const BucketOrder*)b;
+    if (x->size != y->size) return x->size > y->size ? -1 : 1;
+    return x->bucket < y->bucket ? -1 : (x->bucket > y->bucket ? 1 : 0);
+}
+
+typedef struct KeyedInput {
+    StringId id;
+    u32 input;
+} KeyedInput;
+
+static int compareKeyed(const void* a, const void* b)
+{
+    const KeyedInput* x = (const KeyedInput*)a;
+    const KeyedInput* y = (const KeyedInput*)b;
+    if (x->id != y->id) return x->id < y->id ? -1 : 1;
+    return x->input < y->input ? -1 : (x->input > y->input ? 1 : 0);
+}
+
+// CHD: place the biggest buckets first, for each one search for a
+// displacement that sends all of its keys to free slots
+static bool buildDisplacements(const StringId* ids, u32 count, u32 bucketCount, u32* displacements, u32* slotOfKey)
+{
+    u32* bucketStart = (u32*)MEM_CALLOC(sizeof(u32) * (bucketCount + 1), MEM_TAG_TEMP);
+    u32* keysByBucket = (u32*)MEM_ALLOC(sizeof(u32) * count, MEM_TAG_TEMP);
+    BucketOrder* order = (BucketOrder*)MEM_ALLOC(sizeof(BucketOrder) * bucketCount, MEM_TAG_TEMP);
+    u8* taken = (u8*)MEM_CALLOC(count, MEM_TAG_TEMP);
+    bool ok = bucketStart && keysByBucket && order && taken;
+
+    u32 maxBucket = 0;
+    if (ok)
+    {
+        for (u32 i = 0; i < count; i++)
+            bucketStart[bucketOf(ids[i], bucketCount) + 1]++;
+        for (u32 b = 0; b < bucketCount; b++)
+        {
+            order[b].bucket = b;
+            order[b].size = bucketStart[b + 1];
+            if (order[b].size > maxBucket) maxBucket = order[b].size;
+            bucketStart[b + 1] += bucketStart[b];
+        }
+
+        u32* fill = (u32*)MEM_ALLOC(sizeof(u32) * bucketCount, MEM_TAG_TEMP);
+        ok = fill != NULL;
+        if (ok)
+        {
+            memcpy(fill, bucketStart, sizeof(u32) * bucketCount);
+            for (u32 i = 0; i < count; i++)
+                keysByBucket[fill[bucketOf(ids[i], bucketCount)]++] = i;
+            MEM_FREE(fill);
+        }
+        qsort(order, bucketCount, sizeof(BucketOrder), compareBucketSize);
+    }
+
+    u32* candidate = ok ? (u32*)MEM_ALLOC(sizeof(u32) * (maxBucket + 1), MEM_TAG_TEMP) : NULL;
+    ok = ok && candidate;
+
+    for (u32 o = 0; ok && o < bucketCount; o++)
+    {
+        const u32 bucket = order[o].bucket;
+        const u32 size = order[o].size;
+        const u32* keys = &keysByBucket[bucketStart[bucket]];
+        displacements[bucket] = 0;
+        if (size == 0) continue;
+
+        bool placed = false;
+        for (u32 d = 0; d < MAX_DISPLACEMENT && !placed; d++)
+        {
+            placed = true;
+            for (u32 k = 0; k < size && placed; k++)
+            {
+                candidate[k] = slotOf(ids[keys[k]], d, count);
+                if (taken[candidate[k]]) placed = false;
+                for (u32 j = 0; j < k && placed; j++)
+                    if (candidate[j] == candidate[k]) placed = false;
+            }
+            if (placed)
+            {
+                displacements[bucket] = d;
+                for (u32 k = 0; k < size; k++)
+                {
+                    taken[candidate[k]] = 1;
+                    slotOfKey[keys[k]] = candidate[k];
+                }
+            }
+        }
+        if (!placed)
+        {
+            ERROR("Resource index bake found no displacement for a bucket of %u keys", size);
+            ok = false;
+        }
+    }
+
+    MEM_FREE(bucketStart);
+    MEM_FREE(keysByBucket);
+    MEM_FREE(order);
+    MEM_FREE(taken);
+    MEM_FREE(candidate);
+    return ok;
+}
+
+static bool writeFile(const char* path, const void* data, u64 size)
+{
+    FILE* file = NULL;
+#ifdef _MSC_VER
+    fopen_s(&file, path, "wb");
+#else
+    file = fopen(path, "wb");
+#endif
+    if (!file)
+    {
+        ERROR("Failed to open %s for writing", path);
+        return false;
+    }
+    const bool ok = fwrite(data, 1, (size_t)size, file) == size;
+    fclose(file);
+    if (!ok) ERROR("Failed to write %s", path);
+    return ok;
+}
+
+bool writeResourceIndex(const ResourceIndexInput* inputs, u32 count, const char* outPath)
+{
+    // drop the stage files of one shader, which share a name and a stem path;
+    // any other repeat would lose a path, so it fails the bake
+    KeyedInput* keyed = (KeyedInput*)MEM_ALLOC(sizeof(KeyedInput) * (count ? count : 1), MEM_TAG_TEMP);
+    if (!keyed) return false;
+    for (u32 i = 0; i < count; i++)
+    {
+        keyed[i].id = sidHash(inputs[i].name);
+        keyed[i].input = i;
+    }
+    qsort(keyed, count, sizeof(KeyedInput), compareKeyed);
+
+    u32 unique = 0;
+    for (u32 i = 0; i < count; i++)
+    {
+        if (unique > 0 && keyed[unique - 1].id == keyed[i].id)
+        {
+            const ResourceIndexInput* a = &inputs[keyed[unique - 1].input];
+            const ResourceIndexInput* b = &inputs[keyed[i].input];
+            if (a->kind == RESOURCE_SHADER && b->kind == RESOURCE_SHADER &&
+                strcmp(a->name, b->name) == 0 && strcmp(a->path, b->path) == 0)
+                continue;
+
+            ERROR("Resources %s and %s collide as \"%s\" and \"%s\", rename one", a->path, b->path, a->name, b->name);
+            MEM_FREE(keyed);
+            return false;
+        }
+        keyed[unique++] = keyed[i];
+    }
+
+    const u32 bucketCount = unique / KEYS_PER_BUCKET + 1;
+    u64 pathBytes = 0;
+    for (u32 i = 0; i < unique; i++)
+        pathBytes += strlen(inputs[keyed[i].input].path) + 1;
+
+    ResourceIndexHeader header;
+    header.magic = RESOURCE_INDEX_MAGIC;
+    header.version = RESOURCE_INDEX_VERSION;
+    header.count = unique;
+    header.bucketCount = bucketCount;
+    header.displacementOffset = sizeof(ResourceIndexHeader);
+    header.entriesOffset = (header.displacementOffset + bucketCount * (u32)sizeof(u32) + 7) & ~7u;
+    header.pathsOffset = header.entriesOffset + unique * (u32)sizeof(ResourceIndexEntry);
+    // an extra NUL keeps every path offset strictly inside the block
+    header.fileSize = header.pathsOffset + (u32)pathBytes + 1;
+
+    u8* file = (u8*)MEM_CALLOC(header.fileSize, MEM_TAG_TEMP);
+    StringId* ids = (StringId*)MEM_ALLOC(sizeof(StringId) * (unique ? unique : 1), MEM_TAG_TEMP);
+    u32* slotOfKey = (u32*)MEM_ALLOC(sizeof(u32) * (unique ? unique : 1), MEM_TAG_TEMP);
+    bool ok = file && ids && slotOfKey;
+
+    if (ok)
+    {
+        for (u32 i = 0; i < unique; i++)
+            ids[i] = keyed[i].id;
+        u32* displacements = (u32*)(file + header.displacementOffset);
+        ok = unique == 0 || buildDisplacements(ids, unique, bucketCount, displacements, slotOfKey);
+    }
+
+    if (ok)
+    {
+        memcpy(file, &header, sizeof(header));
+        ResourceIndexEntry* entries = (ResourceIndexEntry*)(file + header.entriesOffset);
+        char* paths = (char*)(file + header.pathsOffset);
+        u32 pathOffset = 0;
+        for (u32 i = 0; i < unique; i++)
+        {
+            const ResourceIndexInput* input = &inputs[keyed[i].input];
+            const u32 length = (u32)strlen(input->path);
+            ResourceIndexEntry* entry = &entries[slotOfKey[i]];
+            entry->id = ids[i];
+            entry->pathOffset = pathOffset;
+            entry->pathLength = (u16)length;
+            entry->kind = (u8)input->kind;
+            memcpy(paths + pathOffset, input->path, length + 1);
+            pathOffset += length + 1;
+        }
+        ok = writeFile(outPath, file, header.fileSize);
+    }
+
+    if (ok)
+        INFO("Baked %u resources into %s (%u bytes)", unique, outPath, header.fileSize);
+
+    MEM_FREE(keyed);
+    MEM_FREE(file);
+    MEM_FREE(ids);
+    MEM_FREE(slotOfKey);
+    return ok;
+}
+
+typedef struct ScanList {
+    ResourceIndexInput* inputs;
+    u32 count;
+    u32 capacity;
+} ScanList;
+
+static const char* extensionOf(const char* name)
+{
+    const char* dot = strrchr(name, '.');
+    return dot ? dot + 1 : "";
+}
+
+static bool extensionIs(const char* ext, const char* candidate)
+{
+    for (; *ext && *candidate; ext++, candidate++)
+    {
+        char c = *ext;
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+        if (c != *candidate) return false;
+    }
+    return *ext == *candidate;
+}
+
+static bool kindFromExtension(const char* ext, ResourceKind* kind)
+{
+    if (extensionIs(ext, "vert") || extensionIs(ext, "frag") || extensionIs(ext, "geom"))
+        *kind = RESOURCE_SHADER;
+    else if (extensionIs(ext, "png") || extensionIs(ext, "jpg") || extensionIs(ext, "jpeg") ||
+             extensionIs(ext, "tga") || extensionIs(ext, "bmp"))
+        *kind = RESOURCE_TEXTURE;
+    else if (extensionIs(ext, "fbx") || extensionIs(ext, "obj") || extensionIs(ext, "gltf") || extensionIs(ext, "glb"))
+        *kind = RESOURCE_MODEL;
+    else
+        return false;
+    return true;
+}
+
+static char* copyString(const char* str, u64 length)
+{
+    char* copy = (char*)MEM_ALLOC(length + 1, MEM_TAG_TEMP);
+    if (!copy) return NULL;
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+static bool addFile(ScanList* list, const char* relativePath, const char* fileName)
+{
+    ResourceKind kind;
+    if (!kindFromExtension(extensionOf(fileName), &kind)) return true;
+
+    if (list->count == list->capacity)
+    {
+        const u32 capacity = list->capacity ? list->capacity * 2 : 64;
+        ResourceIndexInput* grown = (ResourceIndexInput*)MEM_ALLOC(sizeof(ResourceIndexInput) * capacity, MEM_TAG_TEMP);
+        if (!grown) return false;
+        if (list->count) memcpy(grown, list->inputs, sizeof(ResourceIndexInput) * list->count);
+        MEM_FREE(list->inputs);
+        list->inputs = grown;
+        list->capacity = capacity;
+    }
+
+    // shaders are looked up by stem, every stage file shares it
+    u64 nameLength = strlen(fileName);
+    u64 pathLength = strlen(relativePath);
+    if (kind == RESOURCE_SHADER)
+    {
+        const u64 extLength = strlen(extensionOf(fileName)) + 1;
+        nameLength -= extLength;
+        pathLength -= extLength;
+    }
+
+    ResourceIndexInput* input = &list->inputs[list->count];
+    input->name = copyString(fileName, nameLength);
+    input->path = copyString(relativePath, pathLength);
+    input->kind = kind;
+    if (!input->name || !input->path)
+    {
+        MEM_FREE((void*)input->name);
+        MEM_FREE((void*)input->path);
+        return false;
+    }
+    list->count++;
+    return true;
+}
+
+// relative is "" at the root, otherwise "dir/" style with a trailing slash
+static bool scanDirectory(ScanList* list, const char* root, const char* relative)
+{
+    char dirPath[MAX_RESOURCE_PATH];
+    char childRelative[MAX_RESOURCE_PATH];
+    snprintf(dirPath, sizeof(dirPath), "%s/%s", root, relative);
+
+#if PLATFORM_WINDOWS
+    char pattern[MAX_RESOURCE_PATH];
+    snprintf(pattern, sizeof(pattern), "%s*", dirPath);
+    WIN32_FIND_DATAA found;
+    HANDLE find = FindFirstFileA(pattern, &found);
+    if (find == INVALID_HANDLE_VALUE)
+    {
+        ERROR("Failed to scan %s", dirPath);
+        return false;
+    }
+
+    bool ok = true;
+    do
+    {
+        const char* name = found.cFileName;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+
+        if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        {
+            snprintf(childRelative, sizeof(childRelative), "%s%s/", relative, name);
+            ok = scanDirectory(list, root, childRelative);
+        }
+        else
+        {
+            snprintf(childRelative, sizeof(childRelative), "%s%s", relative, name);
+            ok = addFile(list, childRelative, name);
+        }
+    } while (ok && FindNextFileA(find, &found));
+    FindClose(find);
+    return ok;
+#else
+    DIR* dir = opendir(dirPath);
+    if (!dir)
+    {
+        ERROR("Failed to scan %s", dirPath);
+        return false;
+    }
+
+    bool ok = true;
+    struct dirent* found;
+    while (ok && (found = readdir(dir)) != NULL)
+    {
+        const char* name = found->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+
+        char fullPath[MAX_RESOURCE_PATH];
+        snprintf(fullPath, sizeof(fullPath), "%s%s", dirPath, name);
+        struct stat info;
+        if (stat(fullPath, &info) != 0) continue;
+
+        if (S_ISDIR(info.st_mode))
+        {
+            snprintf(childRelative, sizeof(childRelative), "%s%s/", relative, name);
+            ok = scanDirectory(list, root, childRelative);
+        }
+        else
+        {
+            snprintf(childRelative, sizeof(childRelative), "%s%s", relative, name);
+            ok = addFile(list, childRelative, name);
+        }
+    }
+    closedir(dir);
+    return ok;
+#endif
+}
+
+bool bakeResourceIndex(const char* resDir, const char* outPath)
+{
+    ScanList list = { 0 };
+    bool ok = scanDirectory(&list, resDir, "");
+    if (ok)
+        ok = writeResourceIndex(list.inputs, list.count, outPath);
+
+    for (u32 i = 0; i < list.count; i++)
+    {
+        MEM_FREE((void*)list.inputs[i].name);
+        MEM_FREE((void*)list.inputs[i].path);
+    }
+    MEM_FREE(list.inputs);
+    return ok;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <druid.h>
+#include "StringId.h"
+
+
+// Baked resource index.
+// The resource set in res/ is fixed per build, so an offline step
+// (GraphicsUniWork --bake-resource-index <resDir> <outFile>) scans it once and
+// writes every asset name into a minimal perfect hash (CHD: hash, displace
+// and compress). At startup the file is memory mapped as is and a lookup by
+// SID costs two hashes and two array reads, with nothing inserted or hashed
+// per asset at load time.
+//
+// File layout, little endian:
+//   ResourceIndexHeader
+//   u32 displacements[bucketCount]
+//   ResourceIndexEntry entries[count]   (slot order, one per asset)
+//   char paths[]                        (NUL terminated, relative to resDir)
+#define RESOURCE_INDEX_MAGIC 0x58444952u // "RIDX"
+#define RESOURCE_INDEX_VERSION 1
+
+typedef enum ResourceKind
+{
+    RESOURCE_SHADER,  // path without extension, the stages share a name
+    RESOURCE_TEXTURE,
+    RESOURCE_MODEL,
+    RESOURCE_KIND_COUNT
+} ResourceKind;
+
+typedef struct ResourceIndexHeader {
+    u32 magic;
+    u32 version;
+    u32 count;
+    u32 bucketCount;
+    u32 displacementOffset;
+    u32 entriesOffset;
+    u32 pathsOffset;
+    u32 fileSize;
+} ResourceIndexHeader;
+
+typedef struct ResourceIndexEntry {
+    StringId id;
+    u32 pathOffset; // from the start of the paths block
+    u16 pathLength;
+    u8 kind;        // ResourceKind
+    u8 pad;
+} ResourceIndexEntry;
+STATIC_ASSERT(sizeof(ResourceIndexEntry) == 16, "index entries are written to disk as is");
+
+typedef struct ResourceIndexInput {
+    const char* name; // looked up with SID(name)
+    const char* path;
+    ResourceKind kind;
+} ResourceIndexInput;
+
+typedef struct ResourceIndex {
+    const u8* data; // mapped file
+    u64 size;
+    const ResourceIndexHeader* header;
+    const u32* displacements;
+    const ResourceIndexEntry* entries;
+    const char* paths;
+    void* mapping;  // platform handles
+    void* file;
+} ResourceIndex;
+
+// offline side
+bool writeResourceIndex(const ResourceIndexInput* inputs, u32 count, const char* outPath);
+bool bakeResourceIndex(const char* resDir, const char* outPath);
+
+// runtime side
+bool resourceIndexOpen(ResourceIndex* index, const char* path);
+void resourceIndexClose(ResourceIndex* index);
+// NULL when the ID isn't in the index
+const ResourceIndexEntry* resourceIndexFind(const ResourceIndex* index, StringId id);
+const char* resourceIndexPath(const ResourceIndex* index, const ResourceIndexEntry* entry);
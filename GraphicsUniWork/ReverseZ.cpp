@@ -0,0 +1,74 @@
+#include "ReverseZ.h"
+#include <math.h>
+
+Mat4 mat4PerspectiveReverseZ(f32 fovRadians, f32 aspect, f32 nearZ)
+{
+    // column major, m[column][row]
+    const f32 f = 1.0f / tanf(fovRadians * 0.5f);
+    Mat4 m = { 0 };
+    m.m[0][0] = f / aspect;
+    m.m[1][1] = f;
+    m.m[2][3] = -1.0f;  // w = -z
+    m.m[3][2] = nearZ;  // z = near, so depth = near / -z
+    return m;
+}
+
+DepthState initDepthState(bool wantReverseZ)
+{
+    DepthState state = { false, 1.0f, GL_LEQUAL };
+
+    if (wantReverseZ)
+    {
+        if (GLEW_VERSION_4_5 || GLEW_ARB_clip_control)
+        {
+            glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+            state.reverseZ = true;
+            state.clearDepth = 0.0f;
+            state.depthFunc = GL_GEQUAL;
+        }
+        else
+        {
+            WARN("glClipControl not supported - using standard depth");
+        }
+    }
+
+    applyDepthState(&state);
+    return state;
+}
+
+Mat4 depthProjection(const DepthState* state, f32 fovRadians, f32 aspect, f32 nearZ, f32 farZ)
+{
+    if (state->reverseZ)
+        return mat4PerspectiveReverseZ(fovRadians, aspect, nearZ);
+
+    return mat4Perspective(fovRadians, aspect, nearZ, farZ);
+}
+
+void applyDepthState(const DepthState* state)
+{
+    glClearDepth(state->clearDepth);
+    glDepthFunc(state->depthFunc);
+}
+
+void attachDepth32F(Framebuffer* fb)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, fb->fbo);
+
+    if (fb->rbo != 0)
+        glDeleteRenderbuffers(1, &fb->rbo);
+
+    glGenRenderbuffers(1, &fb->rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, fb->rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, fb->width, fb->height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    // detach any packed depth-stencil the original creator attached
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, fb->rbo);
+    fb->hasDepth = true;
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        ERROR("Framebuffer not complete after attaching 32F depth!");
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
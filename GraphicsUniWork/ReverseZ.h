@@ -0,0 +1,29 @@
+#pragma once
+#include <druid.h>
+
+
+// Reverse-Z depth: near maps to 1, infinity maps to 0 using a [0,1] clip range.
+// Float depth precision then follows the 1/z distribution of the projection,
+// so distant geometry stops z-fighting without pulling the near plane in.
+typedef struct DepthState {
+    bool reverseZ;      // true when glClipControl(ZERO_TO_ONE) is active
+    f32 clearDepth;     // value to clear the depth buffer to
+    GLenum depthFunc;   // "closer or equal" compare for the current mode
+} DepthState;
+
+// infinite far plane perspective for reverse-Z, expects a [0,1] clip range
+Mat4 mat4PerspectiveReverseZ(f32 fovRadians, f32 aspect, f32 nearZ);
+
+// try to switch the clip range to [0,1], falls back to standard depth if
+// glClipControl is not available
+DepthState initDepthState(bool wantReverseZ);
+
+// projection matching the active depth mode (far is ignored under reverse-Z)
+Mat4 depthProjection(const DepthState* state, f32 fovRadians, f32 aspect, f32 nearZ, f32 farZ);
+
+// set the clear value and compare function for the active depth mode
+void applyDepthState(const DepthState* state);
+
+// swap a framebuffer's depth renderbuffer for a 32F one so depth blits
+// from the GBuffer keep matching formats
+void attachDepth32F(Framebuffer* fb);
@@ -0,0 +1,25 @@
+#pragma once
+
+// SIMD_AVX2 is set when the AVX2 + FMA kernels can be compiled.
+// MSVC enables both with /arch:AVX2, gcc/clang need -mavx2 -mfma.
+#if defined(__AVX2__) && (defined(_MSC_VER) || defined(__FMA__))
+#define SIMD_AVX2 1
+#include <immintrin.h>
+#else
+#define SIMD_AVX2 0
+#endif
+
+// SIMD_SSE2 is set whenever SSE2 integer ops are available, always true on x64.
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#else
+#define SIMD_SSE2 0
+#endif
+
+// pull a cache line towards L1 ahead of use, no-op without SSE
+#if SIMD_SSE2
+#define SIMD_PREFETCH(ptr) _mm_prefetch((const char*)(ptr), _MM_HINT_T0)
+#else
+#define SIMD_PREFETCH(ptr) ((void)(ptr))
+#endif
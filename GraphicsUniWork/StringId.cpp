@@ -0,0 +1,99 @@
+#include "StringId.h"
+#include "StringPool.h"
+#include "FlatMap.h"
+
+#if SID_REVERSE_TABLE
+static FlatMap reverseTable = { 0 };
+#endif
+
+void sidRegister(StringId id, const char* name)
+{
+#if SID_REVERSE_TABLE
+    if (!reverseTable.ctrl && !createFlatMap(&reverseTable, 256, sizeof(StringId), sizeof(const char*), FLAT_MAP_DEFAULT))
+        return;
+
+    // interned so the caller's string doesn't need to outlive the table
+    const char* interned = internedString(intern(name));
+    const char** existing = (const char**)flatMapFind(&reverseTable, &id);
+    if (existing)
+    {
+        if (*existing != interned)
+            ERROR("String ID collision between \"%s\" and \"%s\"", *existing, name);
+        return;
+    }
+    flatMapInsert(&reverseTable, &id, &interned);
+#else
+    (void)id;
+    (void)name;
+#endif
+}
+
+const char* sidName(StringId id)
+{
+#if SID_REVERSE_TABLE
+    if (reverseTable.ctrl)
+    {
+        const char** name = (const char**)flatMapFind(&reverseTable, &id);
+        if (name) return *name;
+    }
+#else
+    (void)id;
+#endif
+    return "<sid>";
+}
+
+void sidReverseTableDestroy()
+{
+#if SID_REVERSE_TABLE
+    if (reverseTable.ctrl)
+        destroyFlatMap(&reverseTable);
+#endif
+}
+
+bool sidMapFromHashMap(SidMap* sidMap, const HashMap* source)
+{
+    if (source->valueSize != sizeof(u32))
+    {
+        ERROR("Resource ID maps hold u32 indices, source map has %u byte values", source->valueSize);
+        return false;
+    }
+    if (!concurrentMapCreate(&sidMap->map, source->count))
+        return false;
+
+    for (u32 i = 0; i < source->capacity; i++)
+    {
+        const Pair* pair = &source->pairs[i];
+        if (!pair->occupied) continue;
+
+        const char* name = (const char*)pair->key;
+        const StringId id = sidHash(name);
+        u32 value;
+        if (concurrentMapFind(&sidMap->map, id, &value))
+        {
+            ERROR("String ID collision for \"%s\", rename the resource", name);
+            continue;
+        }
+
+        memcpy(&value, pair->value, sizeof(u32));
+        if (!concurrentMapInsert(&sidMap->map, id, value))
+        {
+            concurrentMapDestroy(&sidMap->map);
+            return false;
+        }
+        sidRegister(id, name);
+    }
+    return true;
+}
+
+bool sidMapFind(const SidMap* sidMap, StringId id, void* outValue)
+{
+    u32 value;
+    if (!concurrentMapFind(&sidMap->map, id, &value)) return false;
+    memcpy(outValue, &value, sizeof(u32));
+    return true;
+}
+
+void sidMapDestroy(SidMap* sidMap)
+{
+    concurrentMapDestroy(&sidMap->map);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <druid.h>
+#include <type_traits>
+#include "ConcurrentMap.h"
+
+
+// Compile time hashed string IDs (64 bit FNV-1a).
+// SID("Skybox") folds to an integer constant, so resource lookups by name
+// cost one integer probe and no string hashing at runtime. Debug builds keep a
+// reverse table so IDs can still be printed as names.
+typedef u64 StringId;
+
+#define SID_OFFSET_BASIS 0xcbf29ce484222325ull
+#define SID_PRIME 0x100000001b3ull
+
+constexpr StringId sidHash(const char* str)
+{
+    StringId h = SID_OFFSET_BASIS;
+    for (; *str; str++)
+        h = (h ^ (u8)*str) * SID_PRIME;
+    return h;
+}
+
+// integral_constant forces the hash to be evaluated at compile time
+#define SID(str) (std::integral_constant<StringId, sidHash(str)>::value)
+
+constexpr StringId operator""_sid(const char* str, size_t)
+{
+    return sidHash(str);
+}
+
+STATIC_ASSERT(sidHash("") == SID_OFFSET_BASIS, "empty string hashes to the offset basis");
+STATIC_ASSERT(sidHash("a") == 0xaf63dc4c8601ec8cull, "FNV-1a 64 reference value");
+
+#ifdef _DEBUG
+#define SID_REVERSE_TABLE 1
+#else
+#define SID_REVERSE_TABLE 0
+#endif
+
+// debug only, the name is interned, no-op in release
+void sidRegister(StringId id, const char* name);
+// "<sid>" when the ID is unknown or in release builds
+const char* sidName(StringId id);
+void sidReverseTableDestroy();
+
+// resource map keyed by StringId, built from one of druid's name keyed HashMaps.
+// Finds are lock-free, so render code can keep reading while loader threads
+// add resources with concurrentMapInsert on map.
+typedef struct SidMap {
+    ConcurrentMap map;
+} SidMap;
+
+// keys of source must be NUL terminated names, values must be u32 indices
+bool sidMapFromHashMap(SidMap* sidMap, const HashMap* source);
+bool sidMapFind(const SidMap* sidMap, StringId id, void* outValue);
+void sidMapDestroy(SidMap* sidMap);
@@ -0,0 +1,235 @@
+#include "StringPool.h"
+#include "StringId.h"
+#include "VirtualArena.h"
+#include "MemTrack.h"
+#include <atomic>
+#include <mutex>
+#include <new>
+
+// Readers probe an open addressing table of (hash << 32 | id) words with
+// acquire loads. The writer fills in the string and its ID slot before it
+// publishes the table word, so a reader that sees the ID can read the string.
+// Growth builds a new table and swaps the pointer. Old tables stay alive until
+// shutdown because a reader may still be probing one.
+typedef struct InternTable {
+    u32 capacity; // power of two
+    InternTable* previous;
+    std::atomic<u64> entries[1];
+} InternTable;
+
+typedef struct InternRecord {
+    u32 length;
+    char data[1];
+} InternRecord;
+
+static std::atomic<InternTable*> table(nullptr);
+static std::atomic<u32> stringCount(0);
+static std::mutex writeMutex;
+static VirtualArena stringArena = { 0 };
+static VirtualArena idArena = { 0 };
+static InternRecord** records = NULL; // indexed by ID, base of idArena
+
+static inline u32 hashString(const char* str, u32 length)
+{
+    u64 h = SID_OFFSET_BASIS;
+    for (u32 i = 0; i < length; i++)
+        h = (h ^ (u8)str[i]) * SID_PRIME;
+    // 0 marks an empty table word, keep the hash half non zero
+    u32 folded = (u32)(h ^ (h >> 32));
+    return folded ? folded : 1;
+}
+
+static InternTable* createTable(u32 capacity)
+{
+    InternTable* t = (InternTable*)MEM_CALLOC(sizeof(InternTable) + sizeof(std::atomic<u64>) * (capacity - 1), MEM_TAG_HASHMAP);
+    if (!t) return NULL;
+    for (u32 i = 0; i < capacity; i++)
+        new (&t->entries[i]) std::atomic<u64>(0);
+    t->capacity = capacity;
+    return t;
+}
+
+static InternId probe(const InternTable* t, const char* str, u32 length, u32 h)
+{
+    const u32 mask = t->capacity - 1;
+    for (u32 i = h & mask;; i = (i + 1) & mask)
+    {
+        const u64 entry = t->entries[i].load(std::memory_order_acquire);
+        if (entry == 0) return INTERN_NONE;
+        if ((u32)(entry >> 32) != h) continue;
+
+        const InternId id = (InternId)entry;
+        const InternRecord* record = records[id];
+        if (record->length == length && memcmp(record->data, str, length) == 0)
+            return id;
+    }
+}
+
+// caller holds writeMutex
+static void placeEntry(InternTable* t, u64 entry)
+{
+    const u32 mask = t->capacity - 1;
+    u32 i = (u32)(entry >> 32) & mask;
+    while (t->entries[i].load(std::memory_order_relaxed) != 0)
+        i = (i + 1) & mask;
+    t->entries[i].store(entry, std::memory_order_release);
+}
+
+// caller holds writeMutex
+static bool initPool()
+{
+    if (!virtualArenaCreate(&stringArena, STRING_POOL_RESERVE, VIRTUAL_ARENA_DEFAULT))
+        return false;
+    if (!virtualArenaCreate(&idArena, (u64)STRING_POOL_MAX_STRINGS * sizeof(InternRecord*), VIRTUAL_ARENA_DEFAULT))
+    {
+        virtualArenaDestroy(&stringArena);
+        return false;
+    }
+
+    records = (InternRecord**)idArena.base;
+    // ID 0 is INTERN_NONE
+    vacalloc(&idArena, sizeof(InternRecord*), sizeof(InternRecord*));
+
+    InternTable* t = createTable(1024);
+    if (!t)
+    {
+        virtualArenaDestroy(&stringArena);
+        virtualArenaDestroy(&idArena);
+        return false;
+    }
+    table.store(t, std::memory_order_release);
+    return true;
+}
+
+// caller holds writeMutex
+static bool growTable(InternTable* t)
+{
+    InternTable* bigger = createTable(t->capacity * 2);
+    if (!bigger) return false;
+
+    for (u32 i = 0; i < t->capacity; i++)
+    {
+        const u64 entry = t->entries[i].load(std::memory_order_relaxed);
+        if (entry) placeEntry(bigger, entry);
+    }
+    bigger->previous = t;
+    table.store(bigger, std::memory_order_release);
+    return true;
+}
+
+InternId internN(const char* str, u32 length)
+{
+    const u32 h = hashString(str, length);
+
+    InternTable* t = table.load(std::memory_order_acquire);
+    if (t)
+    {
+        const InternId id = probe(t, str, length, h);
+        if (id != INTERN_NONE) return id;
+    }
+
+    std::lock_guard<std::mutex> lock(writeMutex);
+
+    t = table.load(std::memory_order_acquire);
+    if (!t)
+    {
+        if (!initPool())
+        {
+            ERROR("Failed to create the string pool");
+            return INTERN_NONE;
+        }
+        t = table.load(std::memory_order_relaxed);
+    }
+    else
+    {
+        // another writer may have added it while we waited
+        const InternId id = probe(t, str, length, h);
+        if (id != INTERN_NONE) return id;
+    }
+
+    const u32 count = stringCount.load(std::memory_order_relaxed);
+    if (count + 1 >= STRING_POOL_MAX_STRINGS)
+    {
+        ERROR("String pool is full (%u strings)", count);
+        return INTERN_NONE;
+    }
+
+    // keep the table at most half full so probes stay short
+    if ((count + 1) * 2 > t->capacity)
+    {
+        if (!growTable(t))
+        {
+            ERROR("Failed to grow the string pool table");
+            return INTERN_NONE;
+        }
+        t = table.load(std::memory_order_relaxed);
+    }
+
+    InternRecord* record = (InternRecord*)vaalloc(&stringArena, sizeof(InternRecord) + length, alignof(InternRecord));
+    InternRecord** slot = (InternRecord**)vaalloc(&idArena, sizeof(InternRecord*), sizeof(InternRecord*));
+    if (!record || !slot)
+    {
+        ERROR("String pool out of memory");
+        return INTERN_NONE;
+    }
+
+    record->length = length;
+    memcpy(record->data, str, length);
+    record->data[length] = '\0';
+
+    const InternId id = count + 1;
+    *slot = record;
+    stringCount.store(id, std::memory_order_release);
+    placeEntry(t, ((u64)h << 32) | id);
+    return id;
+}
+
+InternId intern(const char* str)
+{
+    return internN(str, (u32)strlen(str));
+}
+
+InternId findInterned(const char* str)
+{
+    InternTable* t = table.load(std::memory_order_acquire);
+    if (!t) return INTERN_NONE;
+
+    const u32 length = (u32)strlen(str);
+    return probe(t, str, length, hashString(str, length));
+}
+
+const char* internedString(InternId id)
+{
+    if (id == INTERN_NONE) return "";
+    assert(id <= stringCount.load(std::memory_order_relaxed) && "unknown intern ID");
+    return records[id]->data;
+}
+
+u32 internedLength(InternId id)
+{
+    if (id == INTERN_NONE) return 0;
+    return records[id]->length;
+}
+
+u32 internedCount()
+{
+    return stringCount.load(std::memory_order_relaxed);
+}
+
+void stringPoolShutdown()
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+
+    InternTable* t = table.exchange(nullptr);
+    while (t)
+    {
+        InternTable* previous = t->previous;
+        MEM_FREE(t);
+        t = previous;
+    }
+
+    virtualArenaDestroy(&stringArena);
+    virtualArenaDestroy(&idArena);
+    records = NULL;
+    stringCount.store(0);
+}
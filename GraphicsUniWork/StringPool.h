@@ -0,0 +1,29 @@
+#pragma once
+#include <druid.h>
+
+
+// Global interned string pool.
+// Each distinct string is stored once, in arena memory that never moves, and
+// gets a small integer ID. Two interned names are equal exactly when their IDs
+// (or their pointers) are equal, so name comparisons become integer compares.
+// Looking up a string that is already interned takes no locks, only adding a
+// new string takes the writer mutex. The pool sets itself up on first use.
+typedef u32 InternId;
+#define INTERN_NONE 0
+
+// reserve sizes for the string bytes and the ID table, address space only
+#define STRING_POOL_RESERVE (256ull * 1024ull * 1024ull)
+#define STRING_POOL_MAX_STRINGS (16u * 1024u * 1024u)
+
+InternId intern(const char* str);
+InternId internN(const char* str, u32 length);
+// INTERN_NONE if the string was never interned, never takes a lock
+InternId findInterned(const char* str);
+
+// the pointer is stable for the lifetime of the pool and NUL terminated
+const char* internedString(InternId id);
+u32 internedLength(InternId id);
+u32 internedCount();
+
+// frees everything, all IDs and pointers become invalid
+void stringPoolShutdown();
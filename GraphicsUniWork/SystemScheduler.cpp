@@ -0,0 +1,279 @@
+#include "SystemScheduler.h"
+#include "MemTrack.h"
+#include <chrono>
+#include <new>
+
+typedef struct SchedulerNode {
+    SystemScheduler* scheduler;
+    u32 index;
+    u32 dependencyCount;
+    u32 firstDependent; // into scheduler->dependents
+    u32 dependentCount;
+    std::atomic<u32> remaining; // dependencies still running this frame
+} SchedulerNode;
+
+typedef std::chrono::steady_clock SchedulerClock;
+
+static f32 elapsedMs(SchedulerClock::time_point start, SchedulerClock::time_point end)
+{
+    return std::chrono::duration<f32, std::milli>(end - start).count();
+}
+
+u32 layoutFieldIndex(const StructLayout* layout, const char* name)
+{
+    for (u32 i = 0; i < layout->count; i++)
+    {
+        if (strcmp(layout->fields[i].name, name) == 0)
+            return i;
+    }
+    return ~0u;
+}
+
+u64 layoutFieldBit(const StructLayout* layout, const char* name)
+{
+    const u32 index = layoutFieldIndex(layout, name);
+    if (index == ~0u)
+    {
+        WARN("Layout %s has no field %s", layout->name, name);
+        return 0;
+    }
+    if (index >= SCHEDULER_MAX_FIELDS)
+    {
+        WARN("Field %s of %s is past the scheduler's field mask", name, layout->name);
+        return SCHEDULER_ALL_FIELDS;
+    }
+    return 1ull << index;
+}
+
+// the done counter holds a std::atomic, so no memset
+static void resetScheduler(SystemScheduler* scheduler)
+{
+    scheduler->systems = NULL;
+    scheduler->timings = NULL;
+    scheduler->count = 0;
+    scheduler->capacity = 0;
+    scheduler->nodes = NULL;
+    scheduler->dependents = NULL;
+    scheduler->edgeCount = 0;
+    scheduler->dirty = false;
+    scheduler->dt = 0.0f;
+    scheduler->done.pending.store(0);
+    scheduler->frameCount = 0;
+    scheduler->lastFrameMs = 0.0f;
+}
+
+bool schedulerCreate(SystemScheduler* scheduler, u32 capacity)
+{
+    resetScheduler(scheduler);
+    if (capacity == 0) capacity = 16;
+
+    scheduler->systems = (SystemDesc*)MEM_ALLOC(sizeof(SystemDesc) * capacity, MEM_TAG_ECS);
+    scheduler->timings = (SystemTiming*)MEM_CALLOC(sizeof(SystemTiming) * capacity, MEM_TAG_ECS);
+    if (!scheduler->systems || !scheduler->timings)
+    {
+        ERROR("Failed to allocate system scheduler");
+        MEM_FREE(scheduler->systems);
+        MEM_FREE(scheduler->timings);
+        scheduler->systems = NULL;
+        scheduler->timings = NULL;
+        return false;
+    }
+    scheduler->capacity = capacity;
+    return true;
+}
+
+static void freeGraph(SystemScheduler* scheduler)
+{
+    if (scheduler->nodes)
+    {
+        for (u32 i = 0; i < scheduler->count; i++)
+            scheduler->nodes[i].~SchedulerNode();
+        MEM_FREE(scheduler->nodes);
+    }
+    MEM_FREE(scheduler->dependents);
+    scheduler->nodes = NULL;
+    scheduler->dependents = NULL;
+    scheduler->edgeCount = 0;
+}
+
+void schedulerDestroy(SystemScheduler* scheduler)
+{
+    freeGraph(scheduler);
+    MEM_FREE(scheduler->systems);
+    MEM_FREE(scheduler->timings);
+    resetScheduler(scheduler);
+}
+
+bool schedulerAddSystem(SystemScheduler* scheduler, const SystemDesc* desc)
+{
+    if (!desc->fn)
+    {
+        ERROR("System %s has no function", desc->name ? desc->name : "<unnamed>");
+        return false;
+    }
+
+    if (scheduler->count == scheduler->capacity)
+    {
+        const u32 capacity = scheduler->capacity * 2;
+        SystemDesc* systems = (SystemDesc*)MEM_ALLOC(sizeof(SystemDesc) * capacity, MEM_TAG_ECS);
+        SystemTiming* timings = (SystemTiming*)MEM_CALLOC(sizeof(SystemTiming) * capacity, MEM_TAG_ECS);
+        if (!systems || !timings)
+        {
+            ERROR("Failed to grow system scheduler");
+            MEM_FREE(systems);
+            MEM_FREE(timings);
+            return false;
+        }
+        memcpy(systems, scheduler->systems, sizeof(SystemDesc) * scheduler->count);
+        memcpy(timings, scheduler->timings, sizeof(SystemTiming) * scheduler->count);
+        MEM_FREE(scheduler->systems);
+        MEM_FREE(scheduler->timings);
+        scheduler->systems = systems;
+        scheduler->timings = timings;
+        scheduler->capacity = capacity;
+    }
+
+    // rebuilt on the next run
+    freeGraph(scheduler);
+    scheduler->systems[scheduler->count++] = *desc;
+    scheduler->dirty = true;
+    return true;
+}
+
+static bool systemsConflict(const SystemDesc* a, const SystemDesc* b)
+{
+    if (!a->archetype || !b->archetype) return true;
+    if (a->archetype->id != b->archetype->id) return false;
+
+    return (a->writeMask & (b->readMask | b->writeMask)) != 0 ||
+           (b->writeMask & a->readMask) != 0;
+}
+
+static bool buildGraph(SystemScheduler* scheduler)
+{
+    const u32 count = scheduler->count;
+    scheduler->nodes = (SchedulerNode*)MEM_ALLOC(sizeof(SchedulerNode) * count, MEM_TAG_ECS);
+    if (!scheduler->nodes)
+    {
+        ERROR("Failed to allocate scheduler graph");
+        return false;
+    }
+    for (u32 i = 0; i < count; i++)
+    {
+        SchedulerNode* node = new (&scheduler->nodes[i]) SchedulerNode();
+        node->scheduler = scheduler;
+        node->index = i;
+        node->dependencyCount = 0;
+        node->dependentCount = 0;
+    }
+
+    // an edge i -> j for every conflicting pair with i registered first
+    u32 edgeCount = 0;
+    for (u32 i = 0; i < count; i++)
+    {
+        for (u32 j = i + 1; j < count; j++)
+        {
+            if (!systemsConflict(&scheduler->systems[i], &scheduler->systems[j])) continue;
+            scheduler->nodes[i].dependentCount++;
+            scheduler->nodes[j].dependencyCount++;
+            edgeCount++;
+        }
+    }
+
+    scheduler->dependents = (u32*)MEM_ALLOC(sizeof(u32) * (edgeCount ? edgeCount : 1), MEM_TAG_ECS);
+    if (!scheduler->dependents)
+    {
+        ERROR("Failed to allocate scheduler edges");
+        freeGraph(scheduler);
+        return false;
+    }
+
+    u32 offset = 0;
+    for (u32 i = 0; i < count; i++)
+    {
+        SchedulerNode* node = &scheduler->nodes[i];
+        node->firstDependent = offset;
+        for (u32 j = i + 1; j < count; j++)
+        {
+            if (systemsConflict(&scheduler->systems[i], &scheduler->systems[j]))
+                scheduler->dependents[offset++] = j;
+        }
+    }
+    scheduler->edgeCount = edgeCount;
+    scheduler->dirty = false;
+    return true;
+}
+
+static void runSystemJob(void* data)
+{
+    SchedulerNode* node = (SchedulerNode*)data;
+    SystemScheduler* scheduler = node->scheduler;
+    const SystemDesc* system = &scheduler->systems[node->index];
+
+    const SchedulerClock::time_point start = SchedulerClock::now();
+    if (system->archetype)
+    {
+        system->fn(*system->archetype, scheduler->dt);
+    }
+    else
+    {
+        Archetype none = { 0, NULL, NULL, 0, 0 };
+        system->fn(none, scheduler->dt);
+    }
+    const f32 ms = elapsedMs(start, SchedulerClock::now());
+
+    // only this job writes the timing, the frame's wait publishes it
+    SystemTiming* timing = &scheduler->timings[node->index];
+    timing->lastMs = ms;
+    timing->avgMs = timing->avgMs == 0.0f ? ms : timing->avgMs + (ms - timing->avgMs) * 0.1f;
+    if (ms > timing->maxMs) timing->maxMs = ms;
+
+    // dependents are queued before this job counts as done, so the frame
+    // counter can't reach zero while work is still pending
+    for (u32 i = 0; i < node->dependentCount; i++)
+    {
+        SchedulerNode* next = &scheduler->nodes[scheduler->dependents[node->firstDependent + i]];
+        if (next->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            jobSubmit(runSystemJob, next, &scheduler->done);
+    }
+}
+
+void schedulerRun(SystemScheduler* scheduler, f32 dt)
+{
+    if (scheduler->count == 0) return;
+    if (scheduler->dirty && !buildGraph(scheduler)) return;
+
+    const SchedulerClock::time_point start = SchedulerClock::now();
+    scheduler->dt = dt;
+    for (u32 i = 0; i < scheduler->count; i++)
+        scheduler->nodes[i].remaining.store(scheduler->nodes[i].dependencyCount, std::memory_order_relaxed);
+
+    for (u32 i = 0; i < scheduler->count; i++)
+    {
+        if (scheduler->nodes[i].dependencyCount == 0)
+            jobSubmit(runSystemJob, &scheduler->nodes[i], &scheduler->done);
+    }
+    jobWait(&scheduler->done);
+
+    scheduler->lastFrameMs = elapsedMs(start, SchedulerClock::now());
+    scheduler->frameCount++;
+}
+
+SystemTiming schedulerTiming(const SystemScheduler* scheduler, u32 system)
+{
+    assert(system < scheduler->count);
+    return scheduler->timings[system];
+}
+
+void schedulerLogTimings(const SystemScheduler* scheduler)
+{
+    INFO("Systems: %u systems, %u dependencies, %u threads, last frame %.3f ms",
+         scheduler->count, scheduler->edgeCount, jobSystemThreadCount(), scheduler->lastFrameMs);
+    for (u32 i = 0; i < scheduler->count; i++)
+    {
+        const SystemTiming* t = &scheduler->timings[i];
+        INFO("  %-24s last %.3f ms  avg %.3f ms  max %.3f ms",
+             scheduler->systems[i].name ? scheduler->systems[i].name : "<unnamed>",
+             t->lastMs, t->avgMs, t->maxMs);
+    }
+}
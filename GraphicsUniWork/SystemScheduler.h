@@ -0,0 +1,60 @@
+#pragma once
+#include <druid.h>
+#include "JobSystem.h"
+
+
+// Parallel system scheduler.
+// Each system declares the archetype it runs over and which fields of that
+// archetype's StructLayout it reads and writes. Two systems conflict when
+// they share an archetype and one writes a field the other touches. The
+// scheduler turns conflicts into a DAG that keeps registration order between
+// conflicting systems and runs everything else concurrently on the job
+// system. A finished system starts its dependents from the worker it ran on.
+//
+// The DAG is rebuilt on the first run after systems are added, not every frame.
+#define SCHEDULER_ALL_FIELDS (~0ull)
+#define SCHEDULER_MAX_FIELDS 64
+
+typedef struct SystemDesc {
+    const char* name;
+    SystemFn fn;
+    Archetype* archetype; // NULL runs exclusively, after and before everything else
+    u64 readMask;         // bit i is field i of archetype->layout
+    u64 writeMask;
+} SystemDesc;
+
+typedef struct SystemTiming {
+    f32 lastMs;
+    f32 avgMs; // moving average over roughly the last 10 runs
+    f32 maxMs;
+} SystemTiming;
+
+typedef struct SystemScheduler {
+    SystemDesc* systems;
+    SystemTiming* timings;
+    u32 count;
+    u32 capacity;
+    struct SchedulerNode* nodes; // DAG, built from systems
+    u32* dependents;
+    u32 edgeCount;
+    bool dirty;
+    f32 dt;
+    JobCounter done;
+    u64 frameCount;
+    f32 lastFrameMs;
+} SystemScheduler;
+
+// ~0u / 0 when the layout has no field with that name
+u32 layoutFieldIndex(const StructLayout* layout, const char* name);
+u64 layoutFieldBit(const StructLayout* layout, const char* name);
+
+bool schedulerCreate(SystemScheduler* scheduler, u32 capacity);
+void schedulerDestroy(SystemScheduler* scheduler);
+bool schedulerAddSystem(SystemScheduler* scheduler, const SystemDesc* desc);
+
+// runs every system once and returns when all of them have finished
+void schedulerRun(SystemScheduler* scheduler, f32 dt);
+
+SystemTiming schedulerTiming(const SystemScheduler* scheduler, u32 system);
+// one INFO line per system plus the frame total and the DAG size
+void schedulerLogTimings(const SystemScheduler* scheduler);
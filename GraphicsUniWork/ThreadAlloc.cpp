@@ -0,0 +1,271 @@
+#include "ThreadAlloc.h"
+#include "VirtualArena.h"
+#include "MemTrack.h"
+#include <atomic>
+#include <mutex>
+
+// Chunk lifetime is tracked with a biased live count. While a thread owns a
+// chunk the count carries LIVE_BIAS, so frees arriving from other threads can
+// never take it to zero early. The owner counts its allocations locally, and
+// when it retires the chunk it swaps the bias for that count in one subtraction.
+// Whoever brings the count to zero pushes the chunk back to the shared stack.
+#define LIVE_BIAS (1u << 30)
+#define CHUNK_HEADER_SIZE 64u
+#define FREE_BATCH_SIZE 32u
+#define NO_CHUNK 0xFFFFFFFFu
+
+typedef struct ChunkHeader {
+    std::atomic<u32> live;
+    std::atomic<u32> nextFree; // link in the shared free stack
+} ChunkHeader;
+static_assert(sizeof(ChunkHeader) <= CHUNK_HEADER_SIZE, "chunk header must fit its reserved space");
+
+typedef struct PendingFree {
+    u32 chunk;
+    u32 count;
+} PendingFree;
+
+typedef struct ThreadCache {
+    u32 epoch;         // allocator generation this cache belongs to
+    u32 chunk;         // owned chunk or NO_CHUNK
+    u32 allocs;        // allocations from the owned chunk not yet freed locally
+    u8* cursor;
+    u8* end;
+    PendingFree pending[FREE_BATCH_SIZE];
+    u32 pendingCount;
+
+    ~ThreadCache() { threadAllocRelease(); }
+} ThreadCache;
+
+static VirtualArena chunkRange = { 0 };
+static std::mutex commitMutex;
+static std::atomic<u64> freeStack(0); // (tag << 32) | (chunk + 1), 0 = empty
+static std::atomic<u32> epoch(0);
+static std::atomic<u64> chunksCommitted(0);
+static std::atomic<u64> chunksInUse(0);
+static std::atomic<u64> largeAllocs(0);
+
+static thread_local ThreadCache cache;
+
+static inline ChunkHeader* chunkHeader(u32 chunk)
+{
+    return (ChunkHeader*)(chunkRange.base + ((u64)chunk << THREAD_ALLOC_CHUNK_SHIFT));
+}
+
+static inline bool inChunkRange(const void* ptr)
+{
+    const u8* p = (const u8*)ptr;
+    return p >= chunkRange.base && p < chunkRange.base + chunkRange.reserved;
+}
+
+static void pushChunk(u32 chunk)
+{
+    ChunkHeader* header = chunkHeader(chunk);
+    u64 head = freeStack.load(std::memory_order_relaxed);
+    u64 next;
+    do
+    {
+        header->nextFree.store((u32)head, std::memory_order_relaxed);
+        // the tag changes on every push so a stale pop can't succeed (ABA)
+        next = (((head >> 32) + 1) << 32) | (u64)(chunk + 1);
+    } while (!freeStack.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
+
+    chunksInUse.fetch_sub(1, std::memory_order_relaxed);
+}
+
+static u32 popChunk()
+{
+    u64 head = freeStack.load(std::memory_order_acquire);
+    while ((u32)head != 0)
+    {
+        const u32 chunk = (u32)head - 1;
+        const u32 link = chunkHeader(chunk)->nextFree.load(std::memory_order_relaxed);
+        const u64 next = (head & 0xFFFFFFFF00000000ull) | link;
+        if (freeStack.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire))
+            return chunk;
+    }
+    return NO_CHUNK;
+}
+
+static u32 acquireChunk()
+{
+    u32 chunk = popChunk();
+    if (chunk == NO_CHUNK)
+    {
+        // slow path, only while the working set is still growing
+        std::lock_guard<std::mutex> lock(commitMutex);
+        u8* mem = (u8*)vaalloc(&chunkRange, THREAD_ALLOC_CHUNK_SIZE, CHUNK_HEADER_SIZE);
+        if (!mem)
+        {
+            ERROR("Thread allocator out of reserved chunks");
+            return NO_CHUNK;
+        }
+        chunk = (u32)((u64)(mem - chunkRange.base) >> THREAD_ALLOC_CHUNK_SHIFT);
+        chunksCommitted.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    chunksInUse.fetch_add(1, std::memory_order_relaxed);
+    chunkHeader(chunk)->live.store(LIVE_BIAS, std::memory_order_relaxed);
+    return chunk;
+}
+
+static void releaseLive(u32 chunk, u32 count)
+{
+    if (chunkHeader(chunk)->live.fetch_sub(count, std::memory_order_acq_rel) == count)
+        pushChunk(chunk);
+}
+
+static void flushFrees(ThreadCache* tc)
+{
+    for (u32 i = 0; i < tc->pendingCount; i++)
+        releaseLive(tc->pending[i].chunk, tc->pending[i].count);
+    tc->pendingCount = 0;
+}
+
+static void retireChunk(ThreadCache* tc)
+{
+    if (tc->chunk == NO_CHUNK) return;
+
+    // trade the owner's bias for the allocations still outstanding
+    releaseLive(tc->chunk, LIVE_BIAS - tc->allocs);
+    tc->chunk = NO_CHUNK;
+    tc->allocs = 0;
+    tc->cursor = tc->end = NULL;
+}
+
+static ThreadCache* getCache()
+{
+    ThreadCache* tc = &cache;
+    const u32 current = epoch.load(std::memory_order_relaxed);
+    if (tc->epoch != current)
+    {
+        // first use on this thread, or left over from a previous init
+        tc->epoch = current;
+        tc->chunk = NO_CHUNK;
+        tc->allocs = 0;
+        tc->cursor = tc->end = NULL;
+        tc->pendingCount = 0;
+    }
+    return tc;
+}
+
+bool threadAllocInit(u64 reserveBytes)
+{
+    if (!virtualArenaCreate(&chunkRange, reserveBytes, VIRTUAL_ARENA_DEFAULT))
+    {
+        ERROR("Failed to reserve thread allocator range");
+        return false;
+    }
+
+    freeStack.store(0);
+    chunksCommitted.store(0);
+    chunksInUse.store(0);
+    // large allocations made before init are still live, keep counting them
+    // epoch 0 is what zero-initialised caches hold, so skip it
+    u32 next = epoch.load() + 1;
+    if (next == 0) next = 1;
+    epoch.store(next);
+    return true;
+}
+
+void threadAllocShutdown()
+{
+    threadAllocRelease();
+    if (chunksInUse.load() != 0)
+        WARN("Thread allocator shut down with %llu chunks still in use", chunksInUse.load());
+
+    virtualArenaDestroy(&chunkRange);
+    epoch.fetch_add(1);
+}
+
+void* talloc(u64 size, u64 align)
+{
+    assert(align != 0 && (align & (align - 1)) == 0 && align <= CHUNK_HEADER_SIZE && "alignment must be a power of two <= 64");
+
+    if (size > THREAD_ALLOC_MAX_SMALL || !chunkRange.base)
+    {
+        assert(align <= 16 && "large thread allocations are only 16 byte aligned");
+        void* ptr = MEM_ALLOC(size, MEM_TAG_GENERAL);
+        if (ptr) largeAllocs.fetch_add(1, std::memory_order_relaxed);
+        return ptr;
+    }
+
+    ThreadCache* tc = getCache();
+    u8* ptr = (u8*)(((uintptr_t)tc->cursor + align - 1) & ~(uintptr_t)(align - 1));
+    if (tc->chunk == NO_CHUNK || ptr + size > tc->end)
+    {
+        retireChunk(tc);
+        const u32 chunk = acquireChunk();
+        if (chunk == NO_CHUNK) return NULL;
+
+        u8* start = (u8*)chunkHeader(chunk);
+        tc->chunk = chunk;
+        tc->cursor = start + CHUNK_HEADER_SIZE;
+        tc->end = start + THREAD_ALLOC_CHUNK_SIZE;
+        ptr = (u8*)(((uintptr_t)tc->cursor + align - 1) & ~(uintptr_t)(align - 1));
+    }
+
+    tc->cursor = ptr + size;
+    tc->allocs++;
+    return ptr;
+}
+
+void tfree(void* ptr)
+{
+    if (!ptr) return;
+
+    if (!inChunkRange(ptr))
+    {
+        largeAllocs.fetch_sub(1, std::memory_order_relaxed);
+        MEM_FREE(ptr);
+        return;
+    }
+
+    ThreadCache* tc = getCache();
+    const u32 chunk = (u32)((u64)((u8*)ptr - chunkRange.base) >> THREAD_ALLOC_CHUNK_SHIFT);
+
+    if (chunk == tc->chunk)
+    {
+        // our own live chunk, no atomics needed, and when it empties we
+        // can rewind and reuse it in place
+        tc->allocs--;
+        if (tc->allocs == 0)
+            tc->cursor = (u8*)chunkHeader(chunk) + CHUNK_HEADER_SIZE;
+        return;
+    }
+
+    for (u32 i = 0; i < tc->pendingCount; i++)
+    {
+        if (tc->pending[i].chunk == chunk)
+        {
+            tc->pending[i].count++;
+            return;
+        }
+    }
+
+    if (tc->pendingCount == FREE_BATCH_SIZE)
+        flushFrees(tc);
+
+    tc->pending[tc->pendingCount].chunk = chunk;
+    tc->pending[tc->pendingCount].count = 1;
+    tc->pendingCount++;
+}
+
+void threadAllocRelease()
+{
+    ThreadCache* tc = &cache;
+    if (tc->epoch != epoch.load(std::memory_order_relaxed) || !chunkRange.base)
+        return;
+
+    flushFrees(tc);
+    retireChunk(tc);
+}
+
+ThreadAllocStats getThreadAllocStats()
+{
+    ThreadAllocStats stats;
+    stats.chunksCommitted = chunksCommitted.load(std::memory_order_relaxed);
+    stats.chunksInUse = chunksInUse.load(std::memory_order_relaxed);
+    stats.largeAllocs = largeAllocs.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <druid.h>
+
+
+// Thread-local allocator for loader threads and parallel systems.
+// Each thread bumps allocations out of its own chunk with no synchronisation.
+// Exhausted chunks are refilled from a shared lock-free chunk stack, and new
+// chunks are committed from one reserved range only when that stack is empty.
+// A chunk goes back to the shared stack once every allocation in it has been
+// freed. Frees, including cross-thread ones, are batched per chunk so the
+// owning chunk's counter is touched once per batch rather than once per free.
+//
+// Allocations larger than THREAD_ALLOC_MAX_SMALL, and any made before
+// threadAllocInit, go to MEM_ALLOC under MEM_TAG_GENERAL, so their bytes show
+// in the memory tracker. They only get 16 byte alignment.
+#define THREAD_ALLOC_CHUNK_SHIFT 16
+#define THREAD_ALLOC_CHUNK_SIZE (1u << THREAD_ALLOC_CHUNK_SHIFT) // 64 KB
+#define THREAD_ALLOC_MAX_SMALL (THREAD_ALLOC_CHUNK_SIZE / 4)
+
+typedef struct ThreadAllocStats {
+    u64 chunksCommitted; // chunks ever taken from the reserved range
+    u64 chunksInUse;     // chunks owned by a thread or still holding live allocations
+    u64 largeAllocs;     // live allocations that fell back to MEM_ALLOC
+} ThreadAllocStats;
+
+// reserveBytes bounds the total small-allocation footprint
+bool threadAllocInit(u64 reserveBytes);
+// every thread must have called threadAllocRelease (or exited) first
+void threadAllocShutdown();
+
+// align must be a power of two no larger than 64
+void* talloc(u64 size, u64 align);
+// safe from any thread, not only the allocating one
+void tfree(void* ptr);
+
+// push this thread's batched frees and hand back its chunk, call before a
+// worker thread goes idle for a long time (thread exit does this automatically)
+void threadAllocRelease();
+
+ThreadAllocStats getThreadAllocStats();
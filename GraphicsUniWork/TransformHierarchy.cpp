@@ -0,0 +1,482 @@
+#include "TransformHierarchy.h"
+#include "JobSystem.h"
+#include "MemTrack.h"
+#include "Simd.h"
+
+#define LOCAL_COLUMNS 10
+#define FLOAT_COLUMNS (LOCAL_COLUMNS + 12)
+
+// every float column, local ones first in Transform order
+static void floatColumns(TransformHierarchy* h, f32** out)
+{
+    f32* local[LOCAL_COLUMNS] = { h->posX, h->posY, h->posZ, h->rotX, h->rotY, h->rotZ, h->rotW,
+                                  h->scaleX, h->scaleY, h->scaleZ };
+    for (u32 i = 0; i < LOCAL_COLUMNS; i++) out[i] = local[i];
+    for (u32 i = 0; i < 12; i++) out[LOCAL_COLUMNS + i] = h->world[i];
+}
+
+// 32-byte aligned slices of one allocation, so AVX loads never split a line pair
+static void* carve(uintptr_t* cursor, u64 bytes)
+{
+    void* p = (void*)*cursor;
+    *cursor += (bytes + 31) & ~31ull;
+    return p;
+}
+
+// base 0 only measures
+static u64 carveAll(TransformHierarchy* h, uintptr_t base)
+{
+    const u64 n = h->capacity;
+    uintptr_t cursor = base;
+    f32** columns[LOCAL_COLUMNS] = { &h->posX, &h->posY, &h->posZ, &h->rotX, &h->rotY, &h->rotZ, &h->rotW,
+                                     &h->scaleX, &h->scaleY, &h->scaleZ };
+    for (u32 i = 0; i < LOCAL_COLUMNS; i++) *columns[i] = (f32*)carve(&cursor, sizeof(f32) * n);
+    for (u32 i = 0; i < 12; i++) h->world[i] = (f32*)carve(&cursor, sizeof(f32) * n);
+    h->parent = (u32*)carve(&cursor, sizeof(u32) * n);
+    h->idOfIndex = (u32*)carve(&cursor, sizeof(u32) * n);
+    h->dirty = (u8*)carve(&cursor, n + 8); // padded for 8-byte dirty tests
+    h->indexOfId = (u32*)carve(&cursor, sizeof(u32) * n);
+    h->freeIds = (u32*)carve(&cursor, sizeof(u32) * n);
+    h->levelStart = (u32*)carve(&cursor, sizeof(u32) * (n + 1));
+    return (u64)(cursor - base);
+}
+
+bool transformHierarchyCreate(TransformHierarchy* hierarchy, u32 capacity)
+{
+    memset(hierarchy, 0, sizeof(TransformHierarchy));
+    hierarchy->capacity = capacity;
+
+    const u64 bytes = carveAll(hierarchy, 0) + 32;
+    hierarchy->memory = MEM_CALLOC(bytes, MEM_TAG_SCENE);
+    if (!hierarchy->memory)
+    {
+        ERROR("Failed to allocate transform hierarchy of %u nodes", capacity);
+        hierarchy->capacity = 0;
+        return false;
+    }
+    carveAll(hierarchy, ((uintptr_t)hierarchy->memory + 31) & ~(uintptr_t)31);
+
+    memset(hierarchy->indexOfId, 0xFF, sizeof(u32) * capacity);
+    // ids pop lowest first
+    for (u32 i = 0; i < capacity; i++)
+        hierarchy->freeIds[i] = capacity - 1 - i;
+    hierarchy->freeCount = capacity;
+    return true;
+}
+
+void transformHierarchyDestroy(TransformHierarchy* hierarchy)
+{
+    MEM_FREE(hierarchy->memory);
+    memset(hierarchy, 0, sizeof(TransformHierarchy));
+}
+
+static void writeLocal(TransformHierarchy* h, u32 index, const Transform* local)
+{
+    h->posX[index] = local->pos.x;
+    h->posY[index] = local->pos.y;
+    h->posZ[index] = local->pos.z;
+    h->rotX[index] = local->rot.x;
+    h->rotY[index] = local->rot.y;
+    h->rotZ[index] = local->rot.z;
+    h->rotW[index] = local->rot.w;
+    h->scaleX[index] = local->scale.x;
+    h->scaleY[index] = local->scale.y;
+    h->scaleZ[index] = local->scale.z;
+    h->dirty[index] = 1;
+    h->anyDirty = true;
+}
+
+static void rebuildOrder(TransformHierarchy* h);
+
+u32 transformNodeAdd(TransformHierarchy* hierarchy, u32 parentId, const Transform* local)
+{
+    if (parentId != TRANSFORM_NO_NODE && !transformNodeValid(hierarchy, parentId))
+    {
+        ERROR("Transform parent %u doesn't exist", parentId);
+        return TRANSFORM_NO_NODE;
+    }
+    if (hierarchy->freeCount == 0)
+    {
+        WARN("Transform hierarchy is full (%u nodes)", hierarchy->capacity);
+        return TRANSFORM_NO_NODE;
+    }
+    // removed nodes still hold their index until the columns are compacted
+    if (hierarchy->count == hierarchy->capacity)
+    {
+        rebuildOrder(hierarchy);
+        if (hierarchy->count == hierarchy->capacity)
+            return TRANSFORM_NO_NODE;
+        // the parent may have hung under a removed node, which the re-sort drops
+        if (parentId != TRANSFORM_NO_NODE && !transformNodeValid(hierarchy, parentId))
+        {
+            ERROR("Transform parent %u was removed with its ancestor", parentId);
+            return TRANSFORM_NO_NODE;
+        }
+    }
+
+    const u32 id = hierarchy->freeIds[--hierarchy->freeCount];
+    const u32 index = hierarchy->count++;
+    hierarchy->parent[index] = parentId == TRANSFORM_NO_NODE ? TRANSFORM_NO_NODE : hierarchy->indexOfId[parentId];
+    hierarchy->idOfIndex[index] = id;
+    hierarchy->indexOfId[id] = index;
+    writeLocal(hierarchy, index, local);
+    hierarchy->orderDirty = true;
+    return id;
+}
+
+void transformNodeRemove(TransformHierarchy* hierarchy, u32 id)
+{
+    if (!transformNodeValid(hierarchy, id)) return;
+
+    // descendants are dropped when the next re-sort can't reach them
+    hierarchy->idOfIndex[hierarchy->indexOfId[id]] = TRANSFORM_NO_NODE;
+    hierarchy->indexOfId[id] = TRANSFORM_NO_NODE;
+    hierarchy->freeIds[hierarchy->freeCount++] = id;
+    hierarchy->orderDirty = true;
+}
+
+bool transformNodeSetParent(TransformHierarchy* hierarchy, u32 id, u32 parentId)
+{
+    if (!transformNodeValid(hierarchy, id) ||
+        (parentId != TRANSFORM_NO_NODE && !transformNodeValid(hierarchy, parentId)))
+    {
+        ERROR("Can't reparent transform %u to %u, no such node", id, parentId);
+        return false;
+    }
+
+    const u32 index = hierarchy->indexOfId[id];
+    const u32 parentIndex = parentId == TRANSFORM_NO_NODE ? TRANSFORM_NO_NODE : hierarchy->indexOfId[parentId];
+    for (u32 p = parentIndex; p != TRANSFORM_NO_NODE; p = hierarchy->parent[p])
+    {
+        if (p == index)
+        {
+            ERROR("Can't parent transform %u under its own subtree", id);
+            return false;
+        }
+    }
+
+    hierarchy->parent[index] = parentIndex;
+    hierarchy->dirty[index] = 1;
+    hierarchy->anyDirty = true;
+    hierarchy->orderDirty = true;
+    return true;
+}
+
+void transformNodeSetLocal(TransformHierarchy* hierarchy, u32 id, const Transform* local)
+{
+    if (!transformNodeValid(hierarchy, id)) return;
+    writeLocal(hierarchy, hierarchy->indexOfId[id], local);
+}
+
+Transform transformNodeLocal(const TransformHierarchy* hierarchy, u32 id)
+{
+    Transform t = {};
+    if (!transformNodeValid(hierarchy, id)) return t;
+
+    const u32 i = hierarchy->indexOfId[id];
+    t.pos.x = hierarchy->posX[i];
+    t.pos.y = hierarchy->posY[i];
+    t.pos.z = hierarchy->posZ[i];
+    t.rot.x = hierarchy->rotX[i];
+    t.rot.y = hierarchy->rotY[i];
+    t.rot.z = hierarchy->rotZ[i];
+    t.rot.w = hierarchy->rotW[i];
+    t.scale.x = hierarchy->scaleX[i];
+    t.scale.y = hierarchy->scaleY[i];
+    t.scale.z = hierarchy->scaleZ[i];
+    return t;
+}
+
+Mat4 transformNodeWorld(const TransformHierarchy* hierarchy, u32 id)
+{
+    Mat4 m = {};
+    m.m[3][3] = 1.0f;
+    if (!transformNodeValid(hierarchy, id)) return m;
+
+    const u32 i = hierarchy->indexOfId[id];
+    for (u32 c = 0; c < 4; c++)
+    {
+        for (u32 r = 0; r < 3; r++)
+            m.m[c][r] = hierarchy->world[c * 3 + r][i];
+    }
+    return m;
+}
+
+// breadth-first from the live roots; whatever isn't reached was removed or
+// hangs off something that was
+static void rebuildOrder(TransformHierarchy* h)
+{
+    const u32 n = h->count;
+    u32* childStart = (u32*)MEM_CALLOC(sizeof(u32) * (n + 1), MEM_TAG_TEMP);
+    u32* children = (u32*)MEM_ALLOC(sizeof(u32) * (n ? n : 1), MEM_TAG_TEMP);
+    u32* order = (u32*)MEM_ALLOC(sizeof(u32) * (n ? n : 1), MEM_TAG_TEMP);
+    u32* newIndex = (u32*)MEM_ALLOC(sizeof(u32) * (n ? n : 1), MEM_TAG_TEMP);
+    f32* scratch = (f32*)MEM_ALLOC(sizeof(f32) * (n ? n : 1), MEM_TAG_TEMP);
+    if (!childStart || !children || !order || !newIndex || !scratch)
+    {
+        ERROR("Failed to re-sort transform hierarchy");
+        MEM_FREE(childStart); MEM_FREE(children); MEM_FREE(order); MEM_FREE(newIndex); MEM_FREE(scratch);
+        return;
+    }
+
+    // children grouped by parent, in index order so siblings keep their order
+    for (u32 i = 0; i < n; i++)
+    {
+        if (h->idOfIndex[i] != TRANSFORM_NO_NODE && h->parent[i] != TRANSFORM_NO_NODE)
+            childStart[h->parent[i] + 1]++;
+    }
+    for (u32 i = 0; i < n; i++) childStart[i + 1] += childStart[i];
+    for (u32 i = 0; i < n; i++)
+    {
+        if (h->idOfIndex[i] != TRANSFORM_NO_NODE && h->parent[i] != TRANSFORM_NO_NODE)
+            children[childStart[h->parent[i]]++] = i;
+    }
+    // the fill advanced each start to the next parent's, shift back
+    for (u32 i = n; i > 0; i--) childStart[i] = childStart[i - 1];
+    childStart[0] = 0;
+
+    memset(newIndex, 0xFF, sizeof(u32) * n);
+    u32 m = 0;
+    for (u32 i = 0; i < n; i++)
+    {
+        if (h->idOfIndex[i] != TRANSFORM_NO_NODE && h->parent[i] == TRANSFORM_NO_NODE)
+            order[m++] = i;
+    }
+
+    h->levelCount = 0;
+    u32 levelBegin = 0;
+    while (levelBegin < m)
+    {
+        const u32 levelEnd = m;
+        h->levelStart[h->levelCount++] = levelBegin;
+        for (u32 k = levelBegin; k < levelEnd; k++)
+        {
+            const u32 node = order[k];
+            for (u32 c = childStart[node]; c < childStart[node + 1]; c++)
+                order[m++] = children[c];
+        }
+        levelBegin = levelEnd;
+    }
+    h->levelStart[h->levelCount] = m;
+
+    for (u32 k = 0; k < m; k++) newIndex[order[k]] = k;
+    for (u32 i = 0; i < n; i++)
+    {
+        const u32 id = h->idOfIndex[i];
+        if (id != TRANSFORM_NO_NODE && newIndex[i] == TRANSFORM_NO_NODE)
+        {
+            h->indexOfId[id] = TRANSFORM_NO_NODE;
+            h->freeIds[h->freeCount++] = id;
+        }
+    }
+
+    // permute every column into the new order
+    f32* columns[FLOAT_COLUMNS];
+    floatColumns(h, columns);
+    for (u32 c = 0; c < FLOAT_COLUMNS; c++)
+    {
+        for (u32 k = 0; k < m; k++) scratch[k] = columns[c][order[k]];
+        memcpy(columns[c], scratch, sizeof(f32) * m);
+    }
+
+    u32* scratch32 = (u32*)scratch;
+    for (u32 k = 0; k < m; k++)
+    {
+        const u32 p = h->parent[order[k]];
+        scratch32[k] = p == TRANSFORM_NO_NODE ? TRANSFORM_NO_NODE : newIndex[p];
+    }
+    memcpy(h->parent, scratch32, sizeof(u32) * m);
+
+    for (u32 k = 0; k < m; k++) scratch32[k] = h->idOfIndex[order[k]];
+    memcpy(h->idOfIndex, scratch32, sizeof(u32) * m);
+    for (u32 k = 0; k < m; k++) h->indexOfId[h->idOfIndex[k]] = k;
+
+    u8* scratch8 = (u8*)scratch;
+    for (u32 k = 0; k < m; k++) scratch8[k] = h->dirty[order[k]];
+    memcpy(h->dirty, scratch8, m);
+
+    h->count = m;
+    h->orderDirty = false;
+    MEM_FREE(childStart); MEM_FREE(children); MEM_FREE(order); MEM_FREE(newIndex); MEM_FREE(scratch);
+}
+
+// world = parent world * translate * rotate * scale, same maths as mat4FromTRS
+static void composeNode(TransformHierarchy* h, u32 i, bool root)
+{
+    const f32 x = h->rotX[i], y = h->rotY[i], z = h->rotZ[i], w = h->rotW[i];
+    const f32 xx = x * x, yy = y * y, zz = z * z;
+    const f32 xy = x * y, xz = x * z, yz = y * z;
+    const f32 wx = w * x, wy = w * y, wz = w * z;
+    const f32 sx = h->scaleX[i], sy = h->scaleY[i], sz = h->scaleZ[i];
+
+    const f32 l[12] = {
+        (1.0f - 2.0f * (yy + zz)) * sx, 2.0f * (xy + wz) * sx, 2.0f * (xz - wy) * sx,
+        2.0f * (xy - wz) * sy, (1.0f - 2.0f * (xx + zz)) * sy, 2.0f * (yz + wx) * sy,
+        2.0f * (xz + wy) * sz, 2.0f * (yz - wx) * sz, (1.0f - 2.0f * (xx + yy)) * sz,
+        h->posX[i], h->posY[i], h->posZ[i],
+    };
+
+    if (root)
+    {
+        for (u32 k = 0; k < 12; k++) h->world[k][i] = l[k];
+        return;
+    }
+
+    const u32 p = h->parent[i];
+    f32 pw[12];
+    for (u32 k = 0; k < 12; k++) pw[k] = h->world[k][p];
+    for (u32 c = 0; c < 4; c++)
+    {
+        for (u32 r = 0; r < 3; r++)
+        {
+            f32 v = pw[r] * l[c * 3] + pw[3 + r] * l[c * 3 + 1] + pw[6 + r] * l[c * 3 + 2];
+            if (c == 3) v += pw[9 + r];
+            h->world[c * 3 + r][i] = v;
+        }
+    }
+}
+
+#if SIMD_AVX2
+static void composeNode8(TransformHierarchy* h, u32 i, bool root)
+{
+    const __m256 x = _mm256_loadu_ps(h->rotX + i), y = _mm256_loadu_ps(h->rotY + i);
+    const __m256 z = _mm256_loadu_ps(h->rotZ + i), w = _mm256_loadu_ps(h->rotW + i);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+    const __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+    const __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+    const __m256 sx = _mm256_mul_ps(two, _mm256_loadu_ps(h->scaleX + i));
+    const __m256 sy = _mm256_mul_ps(two, _mm256_loadu_ps(h->scaleY + i));
+    const __m256 sz = _mm256_mul_ps(two, _mm256_loadu_ps(h->scaleZ + i));
+    // 1 - 2a == 2 * (0.5 - a), so every term shares the doubled scale
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    __m256 l[12];
+    l[0] = _mm256_mul_ps(_mm256_sub_ps(half, _mm256_add_ps(yy, zz)), sx);
+    l[1] = _mm256_mul_ps(_mm256_add_ps(xy, wz), sx);
+    l[2] = _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx);
+    l[3] = _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy);
+    l[4] = _mm256_mul_ps(_mm256_sub_ps(half, _mm256_add_ps(xx, zz)), sy);
+    l[5] = _mm256_mul_ps(_mm256_add_ps(yz, wx), sy);
+    l[6] = _mm256_mul_ps(_mm256_add_ps(xz, wy), sz);
+    l[7] = _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz);
+    l[8] = _mm256_mul_ps(_mm256_sub_ps(half, _mm256_add_ps(xx, yy)), sz);
+    l[9] = _mm256_loadu_ps(h->posX + i);
+    l[10] = _mm256_loadu_ps(h->posY + i);
+    l[11] = _mm256_loadu_ps(h->posZ + i);
+
+    if (root)
+    {
+        for (u32 k = 0; k < 12; k++) _mm256_storeu_ps(h->world[k] + i, l[k]);
+        return;
+    }
+
+    const __m256i parents = _mm256_loadu_si256((const __m256i*)(h->parent + i));
+    __m256 pw[12];
+    for (u32 k = 0; k < 12; k++) pw[k] = _mm256_i32gather_ps(h->world[k], parents, 4);
+    for (u32 c = 0; c < 4; c++)
+    {
+        for (u32 r = 0; r < 3; r++)
+        {
+            __m256 v = c == 3 ? pw[9 + r] : _mm256_setzero_ps();
+            v = _mm256_fmadd_ps(pw[r], l[c * 3], v);
+            v = _mm256_fmadd_ps(pw[3 + r], l[c * 3 + 1], v);
+            v = _mm256_fmadd_ps(pw[6 + r], l[c * 3 + 2], v);
+            _mm256_storeu_ps(h->world[c * 3 + r] + i, v);
+        }
+    }
+}
+#endif
+
+typedef struct TransformBlock {
+    TransformHierarchy* hierarchy;
+    u32 begin;
+    u32 end;
+    bool root;
+} TransformBlock;
+
+static void runBlock(void* data)
+{
+    const TransformBlock* block = (const TransformBlock*)data;
+    TransformHierarchy* h = block->hierarchy;
+    u8* dirty = h->dirty;
+
+    // a node is dirty when it or its parent is, parents already folded in
+    if (!block->root)
+    {
+        for (u32 i = block->begin; i < block->end; i++)
+            dirty[i] |= dirty[h->parent[i]];
+    }
+
+    u32 i = block->begin;
+#if SIMD_AVX2
+    // clean lanes in a dirty group recompute from unchanged inputs, so groups are all-or-nothing
+    for (; i + 8 <= block->end; i += 8)
+    {
+        u64 group;
+        memcpy(&group, dirty + i, sizeof(group));
+        if (group) composeNode8(h, i, block->root);
+    }
+#endif
+    for (; i < block->end; i++)
+    {
+        if (dirty[i]) composeNode(h, i, block->root);
+    }
+}
+
+void transformHierarchyUpdate(TransformHierarchy* hierarchy)
+{
+    if (hierarchy->orderDirty)
+        rebuildOrder(hierarchy);
+    if (hierarchy->count == 0 || !hierarchy->anyDirty) return;
+
+    u32 maxBlocks = 1;
+    for (u32 level = 0; level < hierarchy->levelCount; level++)
+    {
+        const u32 size = hierarchy->levelStart[level + 1] - hierarchy->levelStart[level];
+        const u32 blocks = (size + TRANSFORM_BLOCK - 1) / TRANSFORM_BLOCK;
+        if (blocks > maxBlocks) maxBlocks = blocks;
+    }
+
+    TransformBlock stackBlocks[16];
+    TransformBlock* blocks = maxBlocks <= 16
+        ? stackBlocks
+        : (TransformBlock*)MEM_ALLOC(sizeof(TransformBlock) * maxBlocks, MEM_TAG_TEMP);
+    if (!blocks)
+    {
+        ERROR("Failed to allocate transform update blocks");
+        return;
+    }
+
+    // levels run in order, the blocks within one level in parallel
+    for (u32 level = 0; level < hierarchy->levelCount; level++)
+    {
+        const u32 begin = hierarchy->levelStart[level];
+        const u32 end = hierarchy->levelStart[level + 1];
+        u32 blockCount = 0;
+        for (u32 b = begin; b < end; b += TRANSFORM_BLOCK)
+        {
+            TransformBlock* block = &blocks[blockCount++];
+            block->hierarchy = hierarchy;
+            block->begin = b;
+            block->end = end - b > TRANSFORM_BLOCK ? b + TRANSFORM_BLOCK : end;
+            block->root = level == 0;
+        }
+
+        if (blockCount == 1)
+        {
+            runBlock(&blocks[0]);
+            continue;
+        }
+        JobCounter done;
+        done.pending.store(0, std::memory_order_relaxed);
+        for (u32 b = 1; b < blockCount; b++)
+            jobSubmit(runBlock, &blocks[b], &done);
+        runBlock(&blocks[0]);
+        jobWait(&done);
+    }
+
+    if (blocks != stackBlocks) MEM_FREE(blocks);
+    memset(hierarchy->dirty, 0, hierarchy->count);
+    hierarchy->anyDirty = false;
+}
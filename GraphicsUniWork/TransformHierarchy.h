@@ -0,0 +1,72 @@
+#pragma once
+#include <druid.h>
+
+
+// Parent/child transform hierarchy in breadth-first SoA order.
+// Nodes are kept sorted by depth, and within a depth grouped by parent, so
+// every parent sits before its children and the children of one level read
+// the previous level front to back. Local pos/rot/scale and the world matrix
+// are separate float columns. transformHierarchyUpdate walks the levels in
+// order: each level is cut into blocks that run as jobs, and with AVX2 a
+// block composes eight nodes at a time, gathering the parents' world
+// columns.
+//
+// Setting a node's local transform marks it dirty, and a node is recomputed
+// when it or any ancestor is dirty. Blocks with nothing dirty are skipped
+// after an 8-byte test, so a frame where one rig moves costs that rig plus
+// a scan of the dirty bytes. Adding, removing or reparenting nodes re-sorts
+// the columns on the next update. Ids stay stable across the re-sort.
+//
+// World matrices are affine and column-major like Mat4: world[c * 3 + r] is
+// m[c][r] for the top three rows, the bottom row is implicitly 0 0 0 1.
+#define TRANSFORM_NO_NODE 0xFFFFFFFFu
+#define TRANSFORM_BLOCK 2048 // nodes per job, a multiple of 8
+
+typedef struct TransformHierarchy {
+    u32 count;    // nodes in the columns, including removed ones until the next update
+    u32 capacity;
+
+    // by index, breadth-first after an update
+    f32* posX; f32* posY; f32* posZ;
+    f32* rotX; f32* rotY; f32* rotZ; f32* rotW;
+    f32* scaleX; f32* scaleY; f32* scaleZ;
+    f32* world[12];
+    u32* parent;    // index, TRANSFORM_NO_NODE for roots
+    u32* idOfIndex; // TRANSFORM_NO_NODE once removed
+    u8* dirty;
+
+    // by id
+    u32* indexOfId;
+    u32* freeIds;
+    u32 freeCount;
+
+    u32* levelStart; // levelCount + 1 offsets into the index order
+    u32 levelCount;
+    bool orderDirty;
+    bool anyDirty;  // an update with nothing dirty returns straight away
+    void* memory;
+} TransformHierarchy;
+
+bool transformHierarchyCreate(TransformHierarchy* hierarchy, u32 capacity);
+void transformHierarchyDestroy(TransformHierarchy* hierarchy);
+
+// parentId TRANSFORM_NO_NODE adds a root; returns the new id or
+// TRANSFORM_NO_NODE when full or the parent is invalid
+u32 transformNodeAdd(TransformHierarchy* hierarchy, u32 parentId, const Transform* local);
+// removes the node and everything below it
+void transformNodeRemove(TransformHierarchy* hierarchy, u32 id);
+// fails if the new parent is the node itself or one of its descendants
+bool transformNodeSetParent(TransformHierarchy* hierarchy, u32 id, u32 parentId);
+
+void transformNodeSetLocal(TransformHierarchy* hierarchy, u32 id, const Transform* local);
+Transform transformNodeLocal(const TransformHierarchy* hierarchy, u32 id);
+// as of the last update
+Mat4 transformNodeWorld(const TransformHierarchy* hierarchy, u32 id);
+
+static inline bool transformNodeValid(const TransformHierarchy* hierarchy, u32 id)
+{
+    return id < hierarchy->capacity && hierarchy->indexOfId[id] != TRANSFORM_NO_NODE;
+}
+
+// re-sorts if the shape changed, then recomputes dirty world matrices
+void transformHierarchyUpdate(TransformHierarchy* hierarchy);
@@ -0,0 +1,236 @@
+#include "Vec3Stream.h"
+#include "Simd.h"
+#include <math.h>
+
+#if SIMD_AVX2
+#define VEC3_STREAM_LANES 8
+#else
+#define VEC3_STREAM_LANES 1
+#endif
+
+Vec3Stream vec3Stream(f32* x, f32* y, f32* z, u32 count)
+{
+    Vec3Stream s = { x, y, z, count };
+    return s;
+}
+
+Vec3Stream vec3StreamFromFields(void** fields, u32 xField, u32 count)
+{
+    Vec3Stream s = { (f32*)fields[xField], (f32*)fields[xField + 1], (f32*)fields[xField + 2], count };
+    return s;
+}
+
+// end of the part handled by the simd loops
+static inline u32 simdEnd(u32 count)
+{
+    return count - (count % VEC3_STREAM_LANES);
+}
+
+void vec3StreamAdd(Vec3Stream* out, const Vec3Stream* a, const Vec3Stream* b)
+{
+    const u32 n = out->count;
+    u32 i = 0;
+#if SIMD_AVX2
+    for (; i < simdEnd(n); i += 8)
+    {
+        _mm256_storeu_ps(out->x + i, _mm256_add_ps(_mm256_loadu_ps(a->x + i), _mm256_loadu_ps(b->x + i)));
+        _mm256_storeu_ps(out->y + i, _mm256_add_ps(_mm256_loadu_ps(a->y + i), _mm256_loadu_ps(b->y + i)));
+        _mm256_storeu_ps(out->z + i, _mm256_add_ps(_mm256_loadu_ps(a->z + i), _mm256_loadu_ps(b->z + i)));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        out->x[i] = a->x[i] + b->x[i];
+        out->y[i] = a->y[i] + b->y[i];
+        out->z[i] = a->z[i] + b->z[i];
+    }
+}
+
+void vec3StreamSub(Vec3Stream* out, const Vec3Stream* a, const Vec3Stream* b)
+{
+    const u32 n = out->count;
+    u32 i = 0;
+#if SIMD_AVX2
+    for (; i < simdEnd(n); i += 8)
+    {
+        _mm256_storeu_ps(out->x + i, _mm256_sub_ps(_mm256_loadu_ps(a->x + i), _mm256_loadu_ps(b->x + i)));
+        _mm256_storeu_ps(out->y + i, _mm256_sub_ps(_mm256_loadu_ps(a->y + i), _mm256_loadu_ps(b->y + i)));
+        _mm256_storeu_ps(out->z + i, _mm256_sub_ps(_mm256_loadu_ps(a->z + i), _mm256_loadu_ps(b->z + i)));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        out->x[i] = a->x[i] - b->x[i];
+        out->y[i] = a->y[i] - b->y[i];
+        out->z[i] = a->z[i] - b->z[i];
+    }
+}
+
+void vec3StreamScale(Vec3Stream* out, const Vec3Stream* a, f32 scale)
+{
+    const u32 n = out->count;
+    u32 i = 0;
+#if SIMD_AVX2
+    const __m256 s = _mm256_set1_ps(scale);
+    for (; i < simdEnd(n); i += 8)
+    {
+        _mm256_storeu_ps(out->x + i, _mm256_mul_ps(_mm256_loadu_ps(a->x + i), s));
+        _mm256_storeu_ps(out->y + i, _mm256_mul_ps(_mm256_loadu_ps(a->y + i), s));
+        _mm256_storeu_ps(out->z + i, _mm256_mul_ps(_mm256_loadu_ps(a->z + i), s));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        out->x[i] = a->x[i] * scale;
+        out->y[i] = a->y[i] * scale;
+        out->z[i] = a->z[i] * scale;
+    }
+}
+
+void vec3StreamFma(Vec3Stream* out, const Vec3Stream* a, const Vec3Stream* b, f32 scale)
+{
+    const u32 n = out->count;
+    u32 i = 0;
+#if SIMD_AVX2
+    const __m256 s = _mm256_set1_ps(scale);
+    for (; i < simdEnd(n); i += 8)
+    {
+        _mm256_storeu_ps(out->x + i, _mm256_fmadd_ps(_mm256_loadu_ps(b->x + i), s, _mm256_loadu_ps(a->x + i)));
+        _mm256_storeu_ps(out->y + i, _mm256_fmadd_ps(_mm256_loadu_ps(b->y + i), s, _mm256_loadu_ps(a->y + i)));
+        _mm256_storeu_ps(out->z + i, _mm256_fmadd_ps(_mm256_loadu_ps(b->z + i), s, _mm256_loadu_ps(a->z + i)));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        out->x[i] = a->x[i] + b->x[i] * scale;
+        out->y[i] = a->y[i] + b->y[i] * scale;
+        out->z[i] = a->z[i] + b->z[i] * scale;
+    }
+}
+
+void vec3StreamCross(Vec3Stream* out, const Vec3Stream* a, const Vec3Stream* b)
+{
+    const u32 n = out->count;
+    u32 i = 0;
+#if SIMD_AVX2
+    for (; i < simdEnd(n); i += 8)
+    {
+        const __m256 ax = _mm256_loadu_ps(a->x + i), ay = _mm256_loadu_ps(a->y + i), az = _mm256_loadu_ps(a->z + i);
+        const __m256 bx = _mm256_loadu_ps(b->x + i), by = _mm256_loadu_ps(b->y + i), bz = _mm256_loadu_ps(b->z + i);
+        _mm256_storeu_ps(out->x + i, _mm256_fmsub_ps(ay, bz, _mm256_mul_ps(az, by)));
+        _mm256_storeu_ps(out->y + i, _mm256_fmsub_ps(az, bx, _mm256_mul_ps(ax, bz)));
+        _mm256_storeu_ps(out->z + i, _mm256_fmsub_ps(ax, by, _mm256_mul_ps(ay, bx)));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        // read everything first, out may alias a or b
+        const f32 ax = a->x[i], ay = a->y[i], az = a->z[i];
+        const f32 bx = b->x[i], by = b->y[i], bz = b->z[i];
+        out->x[i] = ay * bz - az * by;
+        out->y[i] = az * bx - ax * bz;
+        out->z[i] = ax * by - ay * bx;
+    }
+}
+
+void vec3StreamNormalize(Vec3Stream* out, const Vec3Stream* a)
+{
+    const u32 n = out->count;
+    u32 i = 0;
+#if SIMD_AVX2
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    for (; i < simdEnd(n); i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(a->x + i), y = _mm256_loadu_ps(a->y + i), z = _mm256_loadu_ps(a->z + i);
+        const __m256 lenSq = _mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_mul_ps(z, z)));
+        // full precision sqrt + div to match v3Norm, lanes with zero length scale by one
+        const __m256 valid = _mm256_cmp_ps(lenSq, zero, _CMP_GT_OQ);
+        const __m256 inv = _mm256_blendv_ps(one, _mm256_div_ps(one, _mm256_sqrt_ps(lenSq)), valid);
+        _mm256_storeu_ps(out->x + i, _mm256_mul_ps(x, inv));
+        _mm256_storeu_ps(out->y + i, _mm256_mul_ps(y, inv));
+        _mm256_storeu_ps(out->z + i, _mm256_mul_ps(z, inv));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        const f32 x = a->x[i], y = a->y[i], z = a->z[i];
+        const f32 lenSq = x * x + y * y + z * z;
+        const f32 inv = lenSq > 0.0f ? 1.0f / sqrtf(lenSq) : 1.0f;
+        out->x[i] = x * inv;
+        out->y[i] = y * inv;
+        out->z[i] = z * inv;
+    }
+}
+
+void vec3StreamDot(f32* out, const Vec3Stream* a, const Vec3Stream* b)
+{
+    const u32 n = a->count;
+    u32 i = 0;
+#if SIMD_AVX2
+    for (; i < simdEnd(n); i += 8)
+    {
+        __m256 d = _mm256_mul_ps(_mm256_loadu_ps(a->z + i), _mm256_loadu_ps(b->z + i));
+        d = _mm256_fmadd_ps(_mm256_loadu_ps(a->y + i), _mm256_loadu_ps(b->y + i), d);
+        d = _mm256_fmadd_ps(_mm256_loadu_ps(a->x + i), _mm256_loadu_ps(b->x + i), d);
+        _mm256_storeu_ps(out + i, d);
+    }
+#endif
+    for (; i < n; i++)
+        out[i] = a->x[i] * b->x[i] + a->y[i] * b->y[i] + a->z[i] * b->z[i];
+}
+
+void vec3StreamLength(f32* out, const Vec3Stream* a)
+{
+    const u32 n = a->count;
+    u32 i = 0;
+#if SIMD_AVX2
+    for (; i < simdEnd(n); i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(a->x + i), y = _mm256_loadu_ps(a->y + i), z = _mm256_loadu_ps(a->z + i);
+        _mm256_storeu_ps(out + i, _mm256_sqrt_ps(_mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_mul_ps(z, z)))));
+    }
+#endif
+    for (; i < n; i++)
+        out[i] = sqrtf(a->x[i] * a->x[i] + a->y[i] * a->y[i] + a->z[i] * a->z[i]);
+}
+
+void vec3StreamDistance(f32* out, const Vec3Stream* a, const Vec3Stream* b)
+{
+    const u32 n = a->count;
+    u32 i = 0;
+#if SIMD_AVX2
+    for (; i < simdEnd(n); i += 8)
+    {
+        const __m256 x = _mm256_sub_ps(_mm256_loadu_ps(a->x + i), _mm256_loadu_ps(b->x + i));
+        const __m256 y = _mm256_sub_ps(_mm256_loadu_ps(a->y + i), _mm256_loadu_ps(b->y + i));
+        const __m256 z = _mm256_sub_ps(_mm256_loadu_ps(a->z + i), _mm256_loadu_ps(b->z + i));
+        _mm256_storeu_ps(out + i, _mm256_sqrt_ps(_mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_mul_ps(z, z)))));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        const f32 x = a->x[i] - b->x[i], y = a->y[i] - b->y[i], z = a->z[i] - b->z[i];
+        out[i] = sqrtf(x * x + y * y + z * z);
+    }
+}
+
+void vec3StreamLoad(Vec3Stream* out, const Vec3* in)
+{
+    for (u32 i = 0; i < out->count; i++)
+    {
+        out->x[i] = in[i].x;
+        out->y[i] = in[i].y;
+        out->z[i] = in[i].z;
+    }
+}
+
+void vec3StreamStore(const Vec3Stream* in, Vec3* out)
+{
+    for (u32 i = 0; i < in->count; i++)
+    {
+        out[i].x = in->x[i];
+        out[i].y = in->y[i];
+        out[i].z = in->z[i];
+    }
+}
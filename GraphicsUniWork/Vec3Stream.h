@@ -0,0 +1,37 @@
+#pragma once
+#include <druid.h>
+
+
+// SoA view over three float columns, e.g. the X/Y/Z fields that VEC3_FIELDS(pos)
+// expands to inside an EntityArena. Kernels run 8 lanes at a time with AVX2
+// and finish the tail with scalar code, so any count is valid.
+// Output streams may alias the inputs.
+typedef struct Vec3Stream {
+    f32* x;
+    f32* y;
+    f32* z;
+    u32 count;
+} Vec3Stream;
+
+Vec3Stream vec3Stream(f32* x, f32* y, f32* z, u32 count);
+// view over consecutive X/Y/Z soa fields starting at xField
+Vec3Stream vec3StreamFromFields(void** fields, u32 xField, u32 count);
+
+// the kernels process out->count elements, inputs must be at least as long
+void vec3StreamAdd(Vec3Stream* out, const Vec3Stream* a, const Vec3Stream* b);
+void vec3StreamSub(Vec3Stream* out, const Vec3Stream* a, const Vec3Stream* b);
+void vec3StreamScale(Vec3Stream* out, const Vec3Stream* a, f32 scale);
+// out = a + b * scale (e.g. pos += vel * dt)
+void vec3StreamFma(Vec3Stream* out, const Vec3Stream* a, const Vec3Stream* b, f32 scale);
+void vec3StreamCross(Vec3Stream* out, const Vec3Stream* a, const Vec3Stream* b);
+// zero length vectors are left untouched
+void vec3StreamNormalize(Vec3Stream* out, const Vec3Stream* a);
+
+// scalar results are written to out[0 .. a->count)
+void vec3StreamDot(f32* out, const Vec3Stream* a, const Vec3Stream* b);
+void vec3StreamLength(f32* out, const Vec3Stream* a);
+void vec3StreamDistance(f32* out, const Vec3Stream* a, const Vec3Stream* b);
+
+// gather/scatter between AoS Vec3 arrays and a stream
+void vec3StreamLoad(Vec3Stream* out, const Vec3* in);
+void vec3StreamStore(const Vec3Stream* in, Vec3* out);
@@ -0,0 +1,176 @@
+#include "VirtualArena.h"
+
+#if PLATFORM_WINDOWS
+// NOGDI keeps wingdi.h from redefining druid's ERROR log macro
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define NOGDI
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// commit at least this much at a time so small allocations don't each hit the OS
+#define VIRTUAL_ARENA_MIN_COMMIT (64ull * 1024ull)
+#define HUGE_PAGE_SIZE (2ull * 1024ull * 1024ull)
+
+static u64 getPageSize()
+{
+#if PLATFORM_WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (u64)info.dwPageSize;
+#else
+    return (u64)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+static inline u64 alignUp(u64 value, u64 align)
+{
+    return (value + align - 1) & ~(align - 1);
+}
+
+static void* reserveMemory(u64 size)
+{
+#if PLATFORM_WINDOWS
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    void* ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return ptr == MAP_FAILED ? NULL : ptr;
+#endif
+}
+
+static bool commitMemory(void* ptr, u64 size)
+{
+#if PLATFORM_WINDOWS
+    return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+    return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+static void decommitMemory(void* ptr, u64 size)
+{
+#if PLATFORM_WINDOWS
+    VirtualFree(ptr, size, MEM_DECOMMIT);
+#else
+    // drop the pages and make the range inaccessible again
+    madvise(ptr, size, MADV_DONTNEED);
+    mprotect(ptr, size, PROT_NONE);
+#endif
+}
+
+static void releaseMemory(void* ptr, u64 size)
+{
+#if PLATFORM_WINDOWS
+    (void)size;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    munmap(ptr, size);
+#endif
+}
+
+bool virtualArenaCreate(VirtualArena* arena, u64 reserveSize, u32 flags)
+{
+    memset(arena, 0, sizeof(VirtualArena));
+
+    const u64 pageSize = getPageSize();
+    u64 step = alignUp(VIRTUAL_ARENA_MIN_COMMIT, pageSize);
+#if !PLATFORM_WINDOWS && defined(MADV_HUGEPAGE)
+    if (flags & VIRTUAL_ARENA_HUGE_PAGES)
+    {
+        // commit whole huge pages so the kernel can back them with THP
+        step = HUGE_PAGE_SIZE;
+    }
+#endif
+    reserveSize = alignUp(reserveSize, step);
+
+    arena->base = (u8*)reserveMemory(reserveSize);
+    if (!arena->base)
+    {
+        ERROR("Failed to reserve %llu bytes for virtual arena", reserveSize);
+        return false;
+    }
+
+#if !PLATFORM_WINDOWS && defined(MADV_HUGEPAGE)
+    if (flags & VIRTUAL_ARENA_HUGE_PAGES)
+        madvise(arena->base, reserveSize, MADV_HUGEPAGE);
+#else
+    (void)flags;
+#endif
+
+    arena->reserved = reserveSize;
+    arena->commitStep = step;
+    return true;
+}
+
+void virtualArenaDestroy(VirtualArena* arena)
+{
+    if (arena->base)
+        releaseMemory(arena->base, arena->reserved);
+    memset(arena, 0, sizeof(VirtualArena));
+}
+
+void* vaalloc(VirtualArena* arena, u64 size, u64 align)
+{
+    assert(align != 0 && (align & (align - 1)) == 0 && "alignment must be a power of two");
+
+    const u64 start = alignUp(arena->used, align);
+    const u64 end = start + size;
+    if (end > arena->reserved || end < start)
+    {
+        ERROR("Virtual arena out of reserved space (%llu of %llu bytes)", end, arena->reserved);
+        return NULL;
+    }
+
+    if (end > arena->committed)
+    {
+        u64 newCommitted = alignUp(end, arena->commitStep);
+        if (newCommitted > arena->reserved) newCommitted = arena->reserved;
+
+        if (!commitMemory(arena->base + arena->committed, newCommitted - arena->committed))
+        {
+            ERROR("Failed to commit virtual arena pages");
+            return NULL;
+        }
+        arena->committed = newCommitted;
+    }
+
+    arena->used = end;
+    if (end > arena->peak) arena->peak = end;
+    return arena->base + start;
+}
+
+void* vacalloc(VirtualArena* arena, u64 size, u64 align)
+{
+    void* ptr = vaalloc(arena, size, align);
+    if (ptr) memset(ptr, 0, size);
+    return ptr;
+}
+
+void virtualArenaReset(VirtualArena* arena)
+{
+    arena->used = 0;
+}
+
+void virtualArenaTrim(VirtualArena* arena)
+{
+    const u64 keep = alignUp(arena->used, arena->commitStep);
+    if (keep >= arena->committed) return;
+
+    decommitMemory(arena->base + keep, arena->committed - keep);
+    arena->committed = keep;
+}
+
+ArenaMark arenaMark(const VirtualArena* arena)
+{
+    ArenaMark mark = { arena->used };
+    return mark;
+}
+
+void arenaRestore(VirtualArena* arena, ArenaMark mark)
+{
+    assert(mark.used <= arena->used && "restoring to a mark taken after the current position");
+    arena->used = mark.used;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <druid.h>
+
+
+// Growable bump allocator backed by reserved virtual memory.
+// The whole range is reserved up front (no physical memory) and pages are
+// committed as allocations reach them, so one arena can hold anything from a
+// few bytes of scratch to many GB of asset data without a worst-case
+// preallocation. Pointers stay valid until the arena is reset or restored
+// past them, the base address never moves.
+typedef struct VirtualArena {
+    u8* base;
+    u64 reserved;   // bytes of address space reserved
+    u64 committed;  // bytes backed by memory, always a multiple of the commit step
+    u64 used;       // bump offset
+    u64 commitStep; // how much to commit at once
+    u64 peak;       // high water mark of used since creation
+} VirtualArena;
+
+// position to roll an arena back to
+typedef struct ArenaMark {
+    u64 used;
+} ArenaMark;
+
+enum VirtualArenaFlags
+{
+    VIRTUAL_ARENA_DEFAULT = 0,
+    // ask the OS to back the range with huge pages where it can (linux THP),
+    // ignored on windows where large pages can't be committed lazily
+    VIRTUAL_ARENA_HUGE_PAGES = 1 << 0,
+};
+
+#define VIRTUAL_ARENA_DEFAULT_ALIGN 16
+
+// reserve reserveSize bytes (rounded up to the page size)
+bool virtualArenaCreate(VirtualArena* arena, u64 reserveSize, u32 flags);
+void virtualArenaDestroy(VirtualArena* arena);
+
+// align must be a power of two, returns NULL when the reservation is exhausted
+void* vaalloc(VirtualArena* arena, u64 size, u64 align);
+// same as vaalloc but zeroes the memory
+void* vacalloc(VirtualArena* arena, u64 size, u64 align);
+
+// O(1), keeps pages committed for the next use
+void virtualArenaReset(VirtualArena* arena);
+// give committed pages above the current offset back to the OS
+void virtualArenaTrim(VirtualArena* arena);
+
+ArenaMark arenaMark(const VirtualArena* arena);
+void arenaRestore(VirtualArena* arena, ArenaMark mark);
+
+#ifdef __cplusplus
+// rolls the arena back when it goes out of scope
+struct ArenaScope
+{
+    VirtualArena* arena;
+    ArenaMark mark;
+
+    explicit ArenaScope(VirtualArena* a) : arena(a), mark(arenaMark(a)) {}
+    ~ArenaScope() { arenaRestore(arena, mark); }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+};
+#endif
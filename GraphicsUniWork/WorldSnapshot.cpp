@@ -0,0 +1,689 @@
+#include "WorldSnapshot.h"
+#include "JobSystem.h"
+#include "MemTrack.h"
+
+// what a section holds, the low bits of its key
+#define SECTION_HEADER 0u
+#define SECTION_SLOTS 1u
+#define SECTION_DENSE 2u
+#define SECTION_FIELD 3u
+
+#define HEADER_WORDS_PER_TABLE 5 // id, slotCount, freeHead, liveCount, openArena, then arena counts
+#define DELTA_BLOCK_BYTES (1024 * 1024)
+#define DELTA_MAX_RUN 0xFFFFFFFFull
+
+static inline u64 sectionKey(u32 archetype, u32 arena, u32 field, u32 kind)
+{
+    return ((u64)archetype << 48) | ((u64)arena << 24) | ((u64)field << 4) | kind;
+}
+
+static inline u64 roundUp8(u64 bytes)
+{
+    return (bytes + 7) & ~7ull;
+}
+
+bool snapshotRingCreate(SnapshotRing* ring, EntityRegistry* registry, u64 maxWorldBytes)
+{
+    memset(ring, 0, sizeof(SnapshotRing));
+    ring->registry = registry;
+
+    // a token needs a zero word before it, so an encoding never outgrows the image
+    const u64 imageReserve = maxWorldBytes + DELTA_BLOCK_BYTES;
+    const u64 storageReserve = maxWorldBytes + 4 * DELTA_BLOCK_BYTES;
+    bool ok = virtualArenaCreate(&ring->images[0].memory, imageReserve, VIRTUAL_ARENA_DEFAULT) &&
+              virtualArenaCreate(&ring->images[1].memory, imageReserve, VIRTUAL_ARENA_DEFAULT);
+    for (u32 i = 0; ok && i < SNAPSHOT_RING_SIZE; i++)
+        ok = virtualArenaCreate(&ring->snapshots[i].storage, storageReserve, VIRTUAL_ARENA_DEFAULT);
+    for (u32 i = 0; ok && i < SNAPSHOT_STRIPES; i++)
+        ok = virtualArenaCreate(&ring->stripeMemory[i], storageReserve, VIRTUAL_ARENA_DEFAULT);
+    if (!ok)
+    {
+        ERROR("Failed to reserve snapshot ring for %llu byte worlds", maxWorldBytes);
+        snapshotRingDestroy(ring);
+        return false;
+    }
+    return true;
+}
+
+void snapshotRingDestroy(SnapshotRing* ring)
+{
+    for (u32 i = 0; i < 2; i++)
+    {
+        virtualArenaDestroy(&ring->images[i].memory);
+        MEM_FREE(ring->images[i].sections);
+    }
+    for (u32 i = 0; i < SNAPSHOT_RING_SIZE; i++)
+        virtualArenaDestroy(&ring->snapshots[i].storage);
+    for (u32 i = 0; i < SNAPSHOT_STRIPES; i++)
+        virtualArenaDestroy(&ring->stripeMemory[i]);
+    MEM_FREE(ring->pending);
+    MEM_FREE(ring->sources);
+    MEM_FREE(ring->header);
+    memset(ring, 0, sizeof(SnapshotRing));
+}
+
+static bool growSections(SnapshotSection** sections, u32* capacity, u32 needed, void*** sources)
+{
+    if (needed <= *capacity) return true;
+
+    u32 grown = *capacity ? *capacity : 64;
+    while (grown < needed) grown *= 2;
+    SnapshotSection* s = (SnapshotSection*)MEM_ALLOC(sizeof(SnapshotSection) * grown, MEM_TAG_ECS);
+    void** src = sources ? (void**)MEM_ALLOC(sizeof(void*) * grown, MEM_TAG_ECS) : NULL;
+    if (!s || (sources && !src))
+    {
+        ERROR("Failed to grow snapshot sections to %u", grown);
+        MEM_FREE(s);
+        MEM_FREE(src);
+        return false;
+    }
+    MEM_FREE(*sections);
+    *sections = s;
+    if (sources)
+    {
+        MEM_FREE(*sources);
+        *sources = src;
+    }
+    *capacity = grown;
+    return true;
+}
+
+static void addSection(SnapshotRing* ring, u64 key, void* source, u64 capacity, u64 live, u64* offset)
+{
+    SnapshotSection* s = &ring->pending[ring->pendingCount];
+    s->key = key;
+    s->offset = *offset;
+    s->capacity = roundUp8(capacity);
+    s->live = live;
+    ring->sources[ring->pendingCount++] = source;
+    *offset += s->capacity;
+}
+
+// lays out the live world: header, then per table its slots and per arena
+// its dense slots and fields. Returns the image size, 0 on failure
+static u64 gatherLayout(SnapshotRing* ring)
+{
+    const EntityRegistry* registry = ring->registry;
+    u32 tableCount = 0;
+    u32 headerWords = 1;
+    u32 sectionCount = 1;
+    for (u32 id = 0; id < registry->tableCapacity; id++)
+    {
+        const EntityTable* table = registry->tables[id];
+        if (!table) continue;
+        tableCount++;
+        headerWords += HEADER_WORDS_PER_TABLE + table->arch->arenaCount;
+        sectionCount += 1 + table->arch->arenaCount * (1 + table->arch->layout->count);
+    }
+
+    if (headerWords > ring->headerCapacity)
+    {
+        MEM_FREE(ring->header);
+        ring->header = (u32*)MEM_ALLOC(sizeof(u32) * headerWords * 2, MEM_TAG_ECS);
+        ring->headerCapacity = ring->header ? headerWords * 2 : 0;
+    }
+    if (!ring->header || !growSections(&ring->pending, &ring->pendingCapacity, sectionCount, &ring->sources))
+    {
+        ERROR("Failed to lay out world snapshot");
+        return 0;
+    }
+
+    u64 offset = 0;
+    ring->pendingCount = 0;
+    addSection(ring, sectionKey(0, 0, 0, SECTION_HEADER), ring->header,
+               sizeof(u32) * headerWords, sizeof(u32) * headerWords, &offset);
+
+    u32* header = ring->header;
+    *header++ = tableCount;
+    for (u32 id = 0; id < registry->tableCapacity; id++)
+    {
+        EntityTable* table = registry->tables[id];
+        if (!table) continue;
+        const Archetype* arch = table->arch;
+        const StructLayout* layout = arch->layout;
+
+        *header++ = id;
+        *header++ = table->slotCount;
+        *header++ = table->freeHead;
+        *header++ = table->liveCount;
+        *header++ = table->openArena;
+        for (u32 a = 0; a < arch->arenaCount; a++)
+            *header++ = arch->arena[a].count;
+
+        addSection(ring, sectionKey(id, 0, 0, SECTION_SLOTS), table->slots,
+                   sizeof(EntitySlot) * (u64)table->slotCapacity, sizeof(EntitySlot) * (u64)table->slotCount, &offset);
+        for (u32 a = 0; a < arch->arenaCount; a++)
+        {
+            const EntityArena* arena = &arch->arena[a];
+            addSection(ring, sectionKey(id, a, 0, SECTION_DENSE), table->denseSlots[a],
+                       sizeof(u32) * (u64)arena->entityCount, sizeof(u32) * (u64)arena->count, &offset);
+            for (u32 f = 0; f < layout->count; f++)
+            {
+                const u64 size = layout->fields[f].size;
+                addSection(ring, sectionKey(id, a, f, SECTION_FIELD), arena->fields[f],
+                           size * arena->entityCount, size * arena->count, &offset);
+            }
+        }
+    }
+    return offset;
+}
+
+static bool layoutsMatch(const SnapshotSection* a, u32 aCount, const SnapshotSection* b, u32 bCount)
+{
+    if (aCount != bCount) return false;
+    for (u32 i = 0; i < aCount; i++)
+    {
+        if (a[i].key != b[i].key || a[i].capacity != b[i].capacity) return false;
+    }
+    return true;
+}
+
+// XOR + RLE stream of 8-byte words: a token word holds the zero words to
+// skip (low half) and the literal words that follow it (high half)
+typedef struct DeltaWriter {
+    VirtualArena* arena;
+    u64* begin;
+    u64* out;
+    u64* end;
+    u64* token; // open literal run, NULL after a zero
+    u64 zeros;  // words skipped since the last token
+    bool failed;
+} DeltaWriter;
+
+static void writerBegin(DeltaWriter* w, VirtualArena* arena)
+{
+    memset(w, 0, sizeof(DeltaWriter));
+    w->arena = arena;
+    w->begin = w->out = w->end = (u64*)(arena->base + roundUp8(arena->used));
+}
+
+// blocks come from a bump arena nobody else touches, so they're contiguous
+static bool writerReserve(DeltaWriter* w, u64 words)
+{
+    while ((u64)(w->end - w->out) < words)
+    {
+        u64* block = (u64*)vaalloc(w->arena, DELTA_BLOCK_BYTES, 8);
+        if (!block || block != w->end)
+        {
+            w->failed = true;
+            return false;
+        }
+        w->end += DELTA_BLOCK_BYTES / sizeof(u64);
+    }
+    return true;
+}
+
+static inline void writerZeros(DeltaWriter* w, u64 words)
+{
+    w->token = NULL;
+    w->zeros += words;
+}
+
+static inline void writerLiteral(DeltaWriter* w, u64 word)
+{
+    if (w->out + 2 > w->end && !writerReserve(w, 2)) return;
+    if (!w->token || (*w->token >> 32) == DELTA_MAX_RUN)
+    {
+        while (w->zeros > DELTA_MAX_RUN)
+        {
+            *w->out++ = DELTA_MAX_RUN;
+            w->zeros -= DELTA_MAX_RUN;
+            if (w->out + 2 > w->end && !writerReserve(w, 2)) return;
+        }
+        w->token = w->out++;
+        *w->token = w->zeros;
+        w->zeros = 0;
+    }
+    *w->out++ = word;
+    *w->token += 1ull << 32;
+}
+
+// trims the arena to what was written, returns the encoded size in bytes
+static u64 writerEnd(DeltaWriter* w)
+{
+    const u64 used = (u64)((u8*)w->out - w->arena->base);
+    if (used <= w->arena->used)
+    {
+        ArenaMark mark = { used };
+        arenaRestore(w->arena, mark);
+    }
+    return (u64)((u8*)w->out - (u8*)w->begin);
+}
+
+static void decodeDelta(u64* image, const u64* encoded, u64 words)
+{
+    const u64* end = encoded + words;
+    u64 pos = 0;
+    while (encoded < end)
+    {
+        const u64 token = *encoded++;
+        pos += (u32)token;
+        for (u32 i = (u32)(token >> 32); i > 0; i--)
+            image[pos++] ^= *encoded++;
+    }
+}
+
+// one section's word range [begin, end) of the new image; old is NULL when
+// the previous snapshot can't be diffed against this one
+static void copyWords(DeltaWriter* w, u64* dst, const u8* src, u64 live, const u64* old, u64 begin, u64 end)
+{
+    const u64 fullWords = live / 8;
+    const u64 fullEnd = end < fullWords ? end : fullWords;
+    u64 i = begin;
+    if (!old)
+    {
+        if (i < fullEnd) memcpy(dst + i, src + i * 8, (fullEnd - i) * 8);
+        for (i = i > fullEnd ? i : fullEnd; i < end; i++)
+        {
+            u64 word = 0;
+            if (i == fullWords) memcpy(&word, src + i * 8, live & 7);
+            dst[i] = word;
+        }
+        return;
+    }
+
+    u64 zeros = 0;
+    for (; i < fullEnd; i++)
+    {
+        // mostly nothing changed, test four words before looking at each
+        if (i + 4 <= fullEnd)
+        {
+            u64 words[4];
+            memcpy(words, src + i * 8, sizeof(words));
+            memcpy(dst + i, words, sizeof(words));
+            if (((words[0] ^ old[i]) | (words[1] ^ old[i + 1]) | (words[2] ^ old[i + 2]) | (words[3] ^ old[i + 3])) == 0)
+            {
+                zeros += 4;
+                i += 3;
+                continue;
+            }
+        }
+
+        u64 word;
+        memcpy(&word, src + i * 8, 8);
+        dst[i] = word;
+        const u64 diff = word ^ old[i];
+        if (diff == 0)
+        {
+            zeros++;
+            continue;
+        }
+        if (zeros)
+        {
+            writerZeros(w, zeros);
+            zeros = 0;
+        }
+        writerLiteral(w, diff);
+    }
+    for (i = i > fullEnd ? i : fullEnd; i < end; i++)
+    {
+        // partial last word, then zeros up to where the old image had data
+        u64 word = 0;
+        if (i == fullWords) memcpy(&word, src + i * 8, live & 7);
+        dst[i] = word;
+        const u64 diff = word ^ old[i];
+        if (diff == 0)
+        {
+            zeros++;
+            continue;
+        }
+        if (zeros)
+        {
+            writerZeros(w, zeros);
+            zeros = 0;
+        }
+        writerLiteral(w, diff);
+    }
+    if (zeros) writerZeros(w, zeros);
+}
+
+static void encodeWhole(DeltaWriter* w, const u64* image, u64 words)
+{
+    u64 zeros = 0;
+    for (u64 i = 0; i < words; i++)
+    {
+        if (image[i] == 0)
+        {
+            zeros++;
+            continue;
+        }
+        if (zeros)
+        {
+            writerZeros(w, zeros);
+            zeros = 0;
+        }
+        writerLiteral(w, image[i]);
+    }
+}
+
+static void dropSnapshot(WorldSnapshot* snapshot)
+{
+    virtualArenaReset(&snapshot->storage);
+    snapshot->sections = NULL;
+    snapshot->sectionCount = 0;
+    snapshot->encodedOffset = 0;
+    snapshot->encodedSize = 0;
+}
+
+typedef struct SnapshotStripe {
+    const SnapshotRing* ring;
+    const SnapshotImage* newest; // NULL when not diffing
+    const SnapshotImage* spare;  // NULL when its old contents don't line up
+    u64* image;
+    u64 begin; // image words
+    u64 end;
+    DeltaWriter writer;
+} SnapshotStripe;
+
+// copies and encodes every section piece inside the stripe; gaps count as
+// zeros so the stream always accounts for the stripe's full width
+static void runStripe(void* data)
+{
+    SnapshotStripe* stripe = (SnapshotStripe*)data;
+    const SnapshotRing* ring = stripe->ring;
+    const u64* old = stripe->newest ? (const u64*)stripe->newest->memory.base : NULL;
+    u64 pos = stripe->begin;
+
+    for (u32 i = 0; i < ring->pendingCount; i++)
+    {
+        const SnapshotSection* s = &ring->pending[i];
+        const u64 first = s->offset / 8;
+        if (first >= stripe->end) break;
+        if (first + s->capacity / 8 <= stripe->begin) continue;
+
+        // live words of either image get encoded, stale ones of the spare zeroed
+        const u64 oldLive = stripe->newest ? stripe->newest->sections[i].live : 0;
+        const u64 covered = roundUp8(s->live > oldLive ? s->live : oldLive) / 8;
+        const u64 stale = stripe->spare ? roundUp8(stripe->spare->sections[i].live) / 8 : s->capacity / 8;
+
+        const u64 begin = stripe->begin > first ? stripe->begin - first : 0;
+        u64 end = covered < stripe->end - first ? covered : stripe->end - first;
+        if (begin < end)
+        {
+            if (old)
+            {
+                writerZeros(&stripe->writer, first + begin - pos);
+                copyWords(&stripe->writer, stripe->image + first, (const u8*)ring->sources[i], s->live,
+                          old + first, begin, end);
+                pos = first + end;
+            }
+            else
+            {
+                copyWords(NULL, stripe->image + first, (const u8*)ring->sources[i], s->live, NULL, begin, end);
+            }
+        }
+
+        const u64 zeroBegin = begin > covered ? begin : covered;
+        end = stale < stripe->end - first ? stale : stripe->end - first;
+        if (zeroBegin < end)
+            memset(stripe->image + first + zeroBegin, 0, (end - zeroBegin) * 8);
+    }
+    if (old && stripe->end > pos)
+        writerZeros(&stripe->writer, stripe->end - pos);
+}
+
+// appends a stripe's stream, folding the zeros the previous stripes ended
+// with into its first token
+static bool appendStripe(DeltaWriter* out, const DeltaWriter* stripe, u64* carry)
+{
+    const u64* token = stripe->begin;
+    if (token == stripe->out)
+    {
+        *carry += stripe->zeros;
+        return true;
+    }
+
+    u64 zeros = *carry + (u32)*token;
+    while (zeros > DELTA_MAX_RUN)
+    {
+        if (!writerReserve(out, 1)) return false;
+        *out->out++ = DELTA_MAX_RUN;
+        zeros -= DELTA_MAX_RUN;
+    }
+    const u64 words = (u64)(stripe->out - stripe->begin);
+    if (!writerReserve(out, words)) return false;
+    *out->out++ = (*token & ~DELTA_MAX_RUN) | zeros;
+    memcpy(out->out, token + 1, (words - 1) * sizeof(u64));
+    out->out += words - 1;
+    *carry = stripe->zeros;
+    return true;
+}
+
+bool snapshotWorld(SnapshotRing* ring, u64 frame)
+{
+    const u64 size = gatherLayout(ring);
+    if (size == 0) return false;
+
+    SnapshotImage* newest = &ring->images[ring->newestImage];
+    SnapshotImage* spare = &ring->images[ring->newestImage ^ 1];
+    WorldSnapshot* previous = ring->count ? &ring->snapshots[ring->newest] : NULL;
+    const bool delta = previous && layoutsMatch(ring->pending, ring->pendingCount, newest->sections, newest->sectionCount);
+    // past their live bytes the spare's sections are zero, unless its layout differs
+    const bool spareMatches = layoutsMatch(ring->pending, ring->pendingCount, spare->sections, spare->sectionCount);
+
+    virtualArenaReset(&spare->memory);
+    u64* image = (u64*)vaalloc(&spare->memory, size, 64);
+    if (!image)
+    {
+        ERROR("World snapshot of %llu bytes doesn't fit the ring", size);
+        return false;
+    }
+
+    // two stripes per thread lets a thread that finishes early take another
+    u32 stripeCount = jobSystemThreadCount() * 2;
+    if (stripeCount > SNAPSHOT_STRIPES) stripeCount = SNAPSHOT_STRIPES;
+    const u64 words = size / 8;
+    const u64 perStripe = (words + stripeCount - 1) / stripeCount;
+
+    SnapshotStripe stripes[SNAPSHOT_STRIPES];
+    JobCounter done;
+    done.pending.store(0, std::memory_order_relaxed);
+    for (u32 i = 0; i < stripeCount; i++)
+    {
+        SnapshotStripe* stripe = &stripes[i];
+        stripe->ring = ring;
+        stripe->newest = delta ? newest : NULL;
+        stripe->spare = spareMatches ? spare : NULL;
+        stripe->image = image;
+        stripe->begin = perStripe * i < words ? perStripe * i : words;
+        stripe->end = perStripe * (i + 1) < words ? perStripe * (i + 1) : words;
+        virtualArenaReset(&ring->stripeMemory[i]);
+        writerBegin(&stripe->writer, &ring->stripeMemory[i]);
+        if (i > 0) jobSubmit(runStripe, stripe, &done);
+    }
+    runStripe(&stripes[0]);
+    jobWait(&done);
+
+    if (previous)
+    {
+        DeltaWriter writer;
+        writerBegin(&writer, &previous->storage);
+        previous->encodedOffset = (u64)((u8*)writer.begin - previous->storage.base);
+        if (delta)
+        {
+            u64 carry = 0;
+            for (u32 i = 0; i < stripeCount; i++)
+            {
+                if (stripes[i].writer.failed || !appendStripe(&writer, &stripes[i].writer, &carry))
+                    writer.failed = true;
+            }
+        }
+        else
+        {
+            encodeWhole(&writer, (const u64*)newest->memory.base, previous->imageSize / 8);
+        }
+        previous->encodedSize = writerEnd(&writer);
+        previous->whole = !delta;
+        if (writer.failed)
+        {
+            // the chain behind the new snapshot is gone, start over from it
+            ERROR("Snapshot delta for frame %llu overflowed its storage, dropping older snapshots", previous->frame);
+            for (u32 i = 0; i < SNAPSHOT_RING_SIZE; i++) dropSnapshot(&ring->snapshots[i]);
+            ring->count = 0;
+        }
+    }
+
+    if (!growSections(&spare->sections, &spare->sectionCapacity, ring->pendingCount, NULL))
+        return false;
+    memcpy(spare->sections, ring->pending, sizeof(SnapshotSection) * ring->pendingCount);
+    spare->sectionCount = ring->pendingCount;
+    spare->size = size;
+
+    // the slot after the newest is the oldest once the ring is full
+    ring->newest = ring->count ? (ring->newest + 1) % SNAPSHOT_RING_SIZE : 0;
+    WorldSnapshot* snapshot = &ring->snapshots[ring->newest];
+    dropSnapshot(snapshot);
+    snapshot->sections = (SnapshotSection*)vaalloc(&snapshot->storage, sizeof(SnapshotSection) * ring->pendingCount, 8);
+    if (!snapshot->sections)
+    {
+        ring->count = 0;
+        return false;
+    }
+    memcpy(snapshot->sections, ring->pending, sizeof(SnapshotSection) * ring->pendingCount);
+    snapshot->sectionCount = ring->pendingCount;
+    snapshot->frame = frame;
+    snapshot->imageSize = size;
+    snapshot->whole = false;
+
+    if (ring->count < SNAPSHOT_RING_SIZE) ring->count++;
+    ring->newestImage ^= 1;
+    return true;
+}
+
+// the world may have grown slot tables since, everything else must line up
+static bool layoutCompatible(const WorldSnapshot* snapshot, const SnapshotSection* world, u32 worldCount)
+{
+    if (snapshot->sectionCount != worldCount) return false;
+    for (u32 i = 1; i < worldCount; i++)
+    {
+        const SnapshotSection* s = &snapshot->sections[i];
+        if (s->key != world[i].key) return false;
+        if ((s->key & 0xF) == SECTION_SLOTS ? world[i].capacity < s->live : world[i].capacity != s->capacity)
+            return false;
+    }
+    return true;
+}
+
+static void scatterImage(SnapshotRing* ring, const WorldSnapshot* snapshot, const u8* image)
+{
+    EntityRegistry* registry = ring->registry;
+    const u32 version = registry->changeVersion.load(std::memory_order_relaxed);
+    const SnapshotSection* sections = snapshot->sections;
+    const u32* header = (const u32*)(image + sections[0].offset);
+    const u32 tableCount = *header++;
+
+    u32 s = 1;
+    for (u32 t = 0; t < tableCount; t++)
+    {
+        EntityTable* table = entityRegistryTable(registry, header[0]);
+        Archetype* arch = table->arch;
+        table->slotCount = header[1];
+        table->freeHead = header[2];
+        table->liveCount = header[3];
+        table->openArena = header[4];
+        header += HEADER_WORDS_PER_TABLE;
+
+        memcpy(table->slots, image + sections[s].offset, sections[s].live);
+        s++;
+        for (u32 a = 0; a < arch->arenaCount; a++)
+        {
+            EntityArena* arena = &arch->arena[a];
+            arena->count = *header++;
+            memcpy(table->denseSlots[a], image + sections[s].offset, sections[s].live);
+            s++;
+            for (u32 f = 0; f < arch->layout->count; f++, s++)
+            {
+                memcpy(arena->fields[f], image + sections[s].offset, sections[s].live);
+                entityMarkChanged(table, a, f, 0, arena->count, version);
+            }
+        }
+    }
+}
+
+bool restoreWorld(SnapshotRing* ring, u64 frame)
+{
+    u32 back = 0;
+    while (back < ring->count && ring->snapshots[(ring->newest + SNAPSHOT_RING_SIZE - back) % SNAPSHOT_RING_SIZE].frame != frame)
+        back++;
+    if (back == ring->count)
+    {
+        WARN("No snapshot of frame %llu to restore", frame);
+        return false;
+    }
+
+    const u32 index = (ring->newest + SNAPSHOT_RING_SIZE - back) % SNAPSHOT_RING_SIZE;
+    WorldSnapshot* target = &ring->snapshots[index];
+    if (!gatherLayout(ring) || !layoutCompatible(target, ring->pending, ring->pendingCount))
+    {
+        ERROR("World archetypes changed since frame %llu, can't restore it", frame);
+        return false;
+    }
+
+    SnapshotImage* newest = &ring->images[ring->newestImage];
+    if (back == 0)
+    {
+        scatterImage(ring, target, newest->memory.base);
+        return true;
+    }
+
+    // rebuild from the nearest image at or after the target, then walk back
+    u32 start = 0;
+    for (u32 b = back; b > 0; b--)
+    {
+        if (ring->snapshots[(ring->newest + SNAPSHOT_RING_SIZE - b) % SNAPSHOT_RING_SIZE].whole)
+        {
+            start = b;
+            break;
+        }
+    }
+
+    // newer snapshots are dropped below, so the newest image can be turned
+    // back in place; past a whole snapshot the spare is rebuilt from zero
+    SnapshotImage* image = newest;
+    if (start != 0)
+    {
+        image = &ring->images[ring->newestImage ^ 1];
+        virtualArenaReset(&image->memory);
+        if (!vacalloc(&image->memory, target->imageSize, 64)) return false;
+        ring->newestImage ^= 1;
+    }
+    for (u32 b = start ? start : 1; b <= back; b++)
+    {
+        const WorldSnapshot* s = &ring->snapshots[(ring->newest + SNAPSHOT_RING_SIZE - b) % SNAPSHOT_RING_SIZE];
+        decodeDelta((u64*)image->memory.base, (const u64*)(s->storage.base + s->encodedOffset), s->encodedSize / 8);
+    }
+    scatterImage(ring, target, image->memory.base);
+
+    // rollback resimulates from here, the newer frames will be taken again
+    for (u32 b = 0; b < back; b++)
+        dropSnapshot(&ring->snapshots[(ring->newest + SNAPSHOT_RING_SIZE - b) % SNAPSHOT_RING_SIZE]);
+    ring->newest = index;
+    ring->count -= back;
+
+    ArenaMark mark = { target->encodedOffset };
+    arenaRestore(&target->storage, mark);
+    target->encodedOffset = 0;
+    target->encodedSize = 0;
+    target->whole = false;
+
+    if (!growSections(&image->sections, &image->sectionCapacity, target->sectionCount, NULL))
+    {
+        ring->count = 0;
+        return false;
+    }
+    memcpy(image->sections, target->sections, sizeof(SnapshotSection) * target->sectionCount);
+    image->sectionCount = target->sectionCount;
+    image->size = target->imageSize;
+    return true;
+}
+
+u64 snapshotRingBytes(const SnapshotRing* ring)
+{
+    u64 bytes = ring->count ? ring->images[ring->newestImage].size : 0;
+    for (u32 b = 0; b < ring->count; b++)
+    {
+        const WorldSnapshot* s = &ring->snapshots[(ring->newest + SNAPSHOT_RING_SIZE - b) % SNAPSHOT_RING_SIZE];
+        bytes += s->encodedSize + sizeof(SnapshotSection) * s->sectionCount;
+    }
+    return bytes;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <druid.h>
+#include "EntityHandle.h"
+#include "VirtualArena.h"
+
+
+// Rolling snapshots of every entity registered with an EntityRegistry.
+// A snapshot is one contiguous image: a header with each table's counts,
+// then each table's slot array, and each arena's dense slots and field
+// columns in order. Every section sits at a fixed offset sized by capacity
+// and holds the live bytes followed by zeros, so two images of the same
+// world line up byte for byte.
+//
+// Only the newest snapshot is kept as a raw image. When a new one is taken,
+// the previous newest is stored as the XOR of the two images, run-length
+// encoded over 8-byte words. Frames where little moved cost a few bytes.
+// Because each delta points at the next newer snapshot, dropping the oldest
+// never breaks the chain. Restoring an older frame starts from the newest
+// image and XORs the deltas back in, newest first. If the world's shape
+// changed between two snapshots (new archetype, grown slot table), the older
+// one is encoded whole instead.
+//
+// Taking a snapshot is one pass that reads the world and the previous image
+// and writes the new image. The pass is cut into word stripes that run as
+// jobs, each encoding into its own buffer, and the stripes' streams are
+// stitched together at the end.
+//
+// Restoring puts entity data, counts and handle slots back exactly, marks
+// every restored row changed, and drops the snapshots newer than it, as
+// rollback resimulates from there.
+#define SNAPSHOT_RING_SIZE 60
+#define SNAPSHOT_STRIPES 16
+
+typedef struct SnapshotSection {
+    u64 key;      // archetype id, arena, field and kind
+    u64 offset;   // in the image, 8-byte aligned
+    u64 capacity; // bytes reserved in the image
+    u64 live;     // bytes holding data, the rest is zero
+} SnapshotSection;
+
+typedef struct SnapshotImage {
+    VirtualArena memory;
+    SnapshotSection* sections; // what the image holds
+    u32 sectionCount;
+    u32 sectionCapacity;
+    u64 size;
+} SnapshotImage;
+
+typedef struct WorldSnapshot {
+    VirtualArena storage;      // sections, then the encoded image
+    SnapshotSection* sections; // in storage
+    u32 sectionCount;
+    u64 frame;
+    u64 imageSize;
+    u64 encodedOffset;         // 0 while this is the newest, raw image
+    u64 encodedSize;
+    bool whole;                // encoded against zeros, not the next snapshot
+} WorldSnapshot;
+
+typedef struct SnapshotRing {
+    EntityRegistry* registry;
+    WorldSnapshot snapshots[SNAPSHOT_RING_SIZE];
+    u32 newest;
+    u32 count;
+    SnapshotImage images[2]; // the newest snapshot's image and a spare
+    u32 newestImage;
+
+    // the live world's layout, gathered on every snapshot and restore
+    SnapshotSection* pending;
+    void** sources;
+    u32 pendingCount;
+    u32 pendingCapacity;
+    u32* header;
+    u32 headerCapacity;
+    VirtualArena stripeMemory[SNAPSHOT_STRIPES];
+} SnapshotRing;
+
+// maxWorldBytes bounds one image; address space is reserved for two raw
+// images, every snapshot's and stripe's worst-case encoding, memory is
+// committed as used
+bool snapshotRingCreate(SnapshotRing* ring, EntityRegistry* registry, u64 maxWorldBytes);
+void snapshotRingDestroy(SnapshotRing* ring);
+
+// evicts the oldest snapshot once SNAPSHOT_RING_SIZE are held
+bool snapshotWorld(SnapshotRing* ring, u64 frame);
+// false if the frame isn't held or the world's archetypes changed since
+bool restoreWorld(SnapshotRing* ring, u64 frame);
+
+// bytes held by the ring's snapshots, raw image included
+u64 snapshotRingBytes(const SnapshotRing* ring);
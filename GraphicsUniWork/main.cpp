@@ -2,6 +2,15 @@
 #include <druid.h>
 #include <iostream>
 #include "Gbuffer.h"
+#include "ReverseZ.h"
+#include "ConstMath.h"
+#include "FastMath.h"
+#include "FrameArena.h"
+#include "MemTrack.h"
+#include "StringId.h"
+#include "StringPool.h"
+#include "ResourceIndex.h"
+#include "JobSystem.h"
 
 
 
@@ -44,6 +53,25 @@ static u32 windowHeight = 720;
 
 static f32 FOV = 80.f;
 
+// Depth mode (reverse-Z with an infinite far plane when supported)
+static const bool useReverseZ = true;
+static DepthState depthState = { 0 };
+
+// resource name lookups keyed by SID()
+static SidMap shaderSids = { 0 };
+static SidMap modelSids = { 0 };
+static SidMap textureSids = { 0 };
+
+// baked by the post-build step with --bake-resource-index; without it assets
+// fall back to their fixed paths
+#define RESOURCE_DIR "../res"
+#define RESOURCE_INDEX_PATH RESOURCE_DIR "/resources.ridx"
+#define RESOURCE_PATH_SIZE 256
+static ResourceIndex resourceIndex = { 0 };
+
+// Per-frame scratch reservation (address space, committed on demand)
+#define FRAME_ARENA_RESERVE (64ull * 1024ull * 1024ull)
+
 void render(f32 dt);
 
 // Forward declarations
@@ -61,10 +89,11 @@ u32 lightingSphereShader = 0;
 //textures
 u32 metalTexture = 0;
 
+// built at compile time so no DLL calls run during static initialisation
 Transform modelTransforms[3] = {
-    {{0.0f, 0.0f, 0.0f}, quatIdentity(), v3Scale(v3One,0.1f)},
-    {{2.0f, 0.0f, 0.0f}, quatMul(quatIdentity() ,quatFromEuler({90,0,0})), v3One},
-    {{0.0f, 0.0f, 0.0f}, quatIdentity(), v3One}
+    {{0.0f, 0.0f, 0.0f}, cm::quatIdentity(), cm::v3Scale(cm::v3One,0.1f)},
+    {{2.0f, 0.0f, 0.0f}, cm::quatMul(cm::quatIdentity() ,cm::quatFromEuler({90,0,0})), cm::v3One},
+    {{0.0f, 0.0f, 0.0f}, cm::quatIdentity(), cm::v3One}
 };
 
 #define UNIFORM_NAME_SIZE 64
@@ -98,6 +127,51 @@ static i32 lightingQuadraticsLocs[MAX_LIGHTS] = { -1 };
 static i32 lightingIntensityLocs[MAX_LIGHTS] = { -1 };
 static i32 lightingRadiiLocs[MAX_LIGHTS] = { -1 };
 
+// druid-owned resource memory recorded with the tracker, released in destroy()
+static u64 resourceTagBytes[MEM_TAG_COUNT] = { 0 };
+
+static u64 hashMapBytes(const HashMap* map)
+{
+    return (u64)map->capacity * sizeof(Pair) + (map->arena ? map->arena->size : 0);
+}
+
+static void recordResourceMemory(const ResourceManager* manager)
+{
+    resourceTagBytes[MEM_TAG_HASHMAP] =
+        hashMapBytes(&manager->textureIDs) + hashMapBytes(&manager->shaderIDs) +
+        hashMapBytes(&manager->mesheIDs) + hashMapBytes(&manager->modelIDs) +
+        hashMapBytes(&manager->materialIDs);
+    resourceTagBytes[MEM_TAG_MESH] =
+        (u64)manager->materialCount * sizeof(Material) +
+        (u64)manager->meshCount * sizeof(Mesh) +
+        (u64)manager->modelCount * sizeof(Model);
+    // GL texture and shader handle arrays, TEXTURE_CPU is kept for pixel data
+    resourceTagBytes[MEM_TAG_GENERAL] =
+        (u64)manager->textureCount * sizeof(u32) +
+        (u64)manager->shaderCount * sizeof(u32) + sizeof(ResourceManager);
+
+    for (u32 i = 0; i < MEM_TAG_COUNT; i++)
+        if (resourceTagBytes[i]) MEM_RECORD((MemTag)i, resourceTagBytes[i]);
+}
+
+static void releaseResourceMemory()
+{
+    for (u32 i = 0; i < MEM_TAG_COUNT; i++)
+    {
+        if (resourceTagBytes[i]) MEM_RELEASE((MemTag)i, resourceTagBytes[i]);
+        resourceTagBytes[i] = 0;
+    }
+}
+
+// where the baked index says the asset lives, or the fallback path
+static const char* resourcePath(StringId id, const char* fallback, char* buffer, u32 size)
+{
+    const ResourceIndexEntry* entry = resourceIndexFind(&resourceIndex, id);
+    if (!entry) return fallback;
+    snprintf(buffer, size, "%s/%s", RESOURCE_DIR, resourceIndexPath(&resourceIndex, entry));
+    return buffer;
+}
+
 f32 randomRange(f32 min, f32 max)
 {
 	f32 random = ((f32)rand()) / (f32)RAND_MAX;
@@ -109,6 +183,20 @@ void init()
 {
     //seed random
     srand((u32)time(NULL));
+
+    // druid has read the resource list by now
+    recordResourceMemory(resources);
+
+    if (!sidMapFromHashMap(&shaderSids, &resources->shaderIDs) ||
+        !sidMapFromHashMap(&modelSids, &resources->modelIDs) ||
+        !sidMapFromHashMap(&textureSids, &resources->textureIDs))
+    {
+        ERROR("Failed to build resource ID maps!");
+        return;
+    }
+
+    if (resourceIndexOpen(&resourceIndex, RESOURCE_INDEX_PATH))
+        INFO("Mapped resource index: %u assets, %llu bytes", resourceIndex.header->count, resourceIndex.size);
     //loop to setup lights
     for (auto i{ 0u }; i < MAX_LIGHTS; i++)
     {
@@ -127,13 +215,14 @@ void init()
         0.1f, 100.0f);       // near/far
 
 
+    char facePaths[6][RESOURCE_PATH_SIZE];
     const char* faces[6] = {
-        "../res/Skybox/right.png",
-        "../res/Skybox/left.png",
-        "../res/Skybox/top.png",
-        "../res/Skybox/bottom.png",
-        "../res/Skybox/front.png",
-        "../res/Skybox/back.png"
+        resourcePath(SID("right.png"), "../res/Skybox/right.png", facePaths[0], sizeof(facePaths[0])),
+        resourcePath(SID("left.png"), "../res/Skybox/left.png", facePaths[1], sizeof(facePaths[1])),
+        resourcePath(SID("top.png"), "../res/Skybox/top.png", facePaths[2], sizeof(facePaths[2])),
+        resourcePath(SID("bottom.png"), "../res/Skybox/bottom.png", facePaths[3], sizeof(facePaths[3])),
+        resourcePath(SID("front.png"), "../res/Skybox/front.png", facePaths[4], sizeof(facePaths[4])),
+        resourcePath(SID("back.png"), "../res/Skybox/back.png", facePaths[5], sizeof(facePaths[5]))
     };
 
     cubeMapTexture = createCubeMapTexture(faces, 6);
@@ -152,7 +241,7 @@ void init()
 
     // get the shader from resource manager
     u32 skyboxID = 0;
-    findInMap(&resources->shaderIDs, "Skybox", &skyboxID);
+    sidMapFind(&shaderSids, SID("Skybox"), &skyboxID);
     skyboxShader = resources->shaderHandles[skyboxID];
 
     // Cache uniform locations
@@ -175,7 +264,7 @@ void init()
 
 
     i32 FBOIDReturn = -1;
-    if (!findInMap(&resources->shaderIDs, "FBOShader", &FBOIDReturn))
+    if (!sidMapFind(&shaderSids, SID("FBOShader"), &FBOIDReturn))
     {
         WARN("Failed to get FBO shader - post-processing disabled");
     }
@@ -183,12 +272,28 @@ void init()
     u32 FBOID = (u32)FBOIDReturn;
     fboShader = resources->shaderHandles[FBOID];
     
+    if (!frameArenasInit(FRAME_ARENA_RESERVE))
+    {
+        ERROR("Failed to create frame arenas!");
+        return;
+    }
+
+    // worker per hardware thread, systems and loaders share the pool
+    if (!jobSystemInit(0))
+    {
+        ERROR("Failed to start job system!");
+        return;
+    }
+
+    // pick the depth mode before any depth targets are cleared
+    depthState = initDepthState(useReverseZ);
+
     //setup GBuffer
     gBuffer = createGBuffer(windowWidth, windowHeight);
    
     //setup gbuffer shaders
     i32 gBufferShaderIDReturn = -1;
-    if (!findInMap(&resources->shaderIDs, "GBuffer", &gBufferShaderIDReturn))
+    if (!sidMapFind(&shaderSids, SID("GBuffer"), &gBufferShaderIDReturn))
     {
 		WARN("Failed to get GBuffer shader");
 	}
@@ -196,7 +301,7 @@ void init()
     gBufferShader = resources->shaderHandles[gBufferShaderID];
 
 	i32 gBufferLightingShaderIDReturn = -1;
-    if (!findInMap(&resources->shaderIDs, "Lighting", &gBufferLightingShaderIDReturn))
+    if (!sidMapFind(&shaderSids, SID("Lighting"), &gBufferLightingShaderIDReturn))
     {
         WARN("Failed to get GBuffer Lighting shader");
     }
@@ -209,34 +314,36 @@ void init()
 
     // Main scene FBO with depth buffer
     mainFBO = createFramebuffer(windowWidth, windowHeight, GL_RGBA16F, true);
+    // match the GBuffer depth format so the depth blit stays valid
+    attachDepth32F(&mainFBO);
 
     // Post-process FBO
     postProcessFBO = createFramebuffer(windowWidth, windowHeight, GL_RGBA16F, false);
 
     //Get model data 
     u32 duckID = 0;
-    findInMap(&resources->modelIDs,"Duck Model.fbx",&duckID);
+    sidMapFind(&modelSids,SID("Duck Model.fbx"),&duckID);
     duckModel = &resources->modelBuffer[duckID];
 
     u32 sheildID = 0;
-    findInMap(&resources->modelIDs,"Shield_Crusader.fbx",&sheildID);
+    sidMapFind(&modelSids,SID("Shield_Crusader.fbx"),&sheildID);
 	shieldModel = &resources->modelBuffer[sheildID];
 
     u32 sphereID = 0;
-    findInMap(&resources->modelIDs,"Ball.obj",&sphereID);
+    sidMapFind(&modelSids,SID("Ball.obj"),&sphereID);
     sphere = &resources->modelBuffer[sphereID];
 
     //Get shaders
     u32 envShaderID = 0;
-    findInMap(&resources->shaderIDs,"eMapping",&envShaderID);
+    sidMapFind(&shaderSids,SID("eMapping"),&envShaderID);
     enviromentShader = resources->shaderHandles[envShaderID];
 
     u32 geomShaderID = 0;
-    findInMap(&resources->shaderIDs,"Geo",&geomShaderID);
+    sidMapFind(&shaderSids,SID("Geo"),&geomShaderID);
     geometryShader = resources->shaderHandles[geomShaderID];
 
     u32 lightSphereShaderID = 0;
-    if (!findInMap(&resources->shaderIDs, "LightingSphere", &lightSphereShaderID))
+    if (!sidMapFind(&shaderSids, SID("LightingSphere"), &lightSphereShaderID))
     {
         WARN("Failed to get Light Sphere shader");
     }
@@ -292,7 +399,7 @@ void init()
 
     //Get textures
     u32 metalTextureID = 0;
-    findInMap(&resources->textureIDs, "metal.jpg", &metalTextureID);
+    sidMapFind(&textureSids, SID("metal.jpg"), &metalTextureID);
     metalTexture = resources->textureHandles[metalTextureID];
     INFO("Initialization complete!");
 }
@@ -307,13 +414,16 @@ void update(f32 dt)
     {
         //animate the lights in a circle
         float speed = 0.5f + i * 0.1f;
-        float angle = SDL_GetTicks() / 1000.0f * speed;
-        LightingPositions[i].x = cosf(angle) * LightingRadii[i];
-        LightingPositions[i].z = sinf(angle) * LightingRadii[i];
+        // wrap in double, fastSinCos is only accurate for small angles
+        f32 angle = (f32)SDL_fmod((f64)SDL_GetTicks() / 1000.0 * speed, 2.0 * SDL_PI_D);
+        f32 s, c;
+        fastSinCos(angle, &s, &c);
+        LightingPositions[i].x = c * LightingRadii[i];
+        LightingPositions[i].z = s * LightingRadii[i];
     }
 
     // Update projection matrix 
-    camera.projection = mat4Perspective(
+    camera.projection = depthProjection(&depthState,
         radians(70.0f),
         (f32)windowWidth / (f32)windowHeight,
         0.1f, 100.0f
@@ -355,7 +465,7 @@ void forwardRenderPass()
 
     bindFramebuffer(&mainFBO);
     glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LEQUAL);
+    glDepthFunc(depthState.depthFunc);
     glDepthMask(GL_TRUE);
 
     // Geom shader (explode)
@@ -430,7 +540,19 @@ void lightingPass()
     if (gEnvIntensityLoc != -1) glUniform1f(gEnvIntensityLoc, envIntensityVal);
     if (gSmoothnessLoc != -1) glUniform1f(gSmoothnessLoc, smoothnessVal);
 
-    // send light uniforms
+    // pack normalised colours and intensities into frame scratch memory
+    Vec3 fallbackColours[MAX_LIGHTS];
+    f32 fallbackIntensities[MAX_LIGHTS];
+    Vec3* lightColours = (Vec3*)frameAlloc(sizeof(Vec3) * MAX_LIGHTS, alignof(Vec3));
+    f32* lightIntensities = (f32*)frameAlloc(sizeof(f32) * MAX_LIGHTS, alignof(f32));
+    if (!lightColours || !lightIntensities)
+    {
+        // the pass is half bound already, so carry on with stack memory
+        WARN("Frame arena exhausted, lighting uses stack scratch");
+        lightColours = fallbackColours;
+        lightIntensities = fallbackIntensities;
+    }
+
     for (auto i{ 0u }; i < MAX_LIGHTS; ++i)
     {
         // Normalize stored colour into 0-1 and separate brightness
@@ -440,21 +562,24 @@ void lightingPass()
         float intensity = r;
         if (g > intensity) intensity = g;
         if (b > intensity) intensity = b;
-        float colorVal[3] = {0.0f, 0.0f, 0.0f};
         if (intensity > 1e-6f)
         {
-            colorVal[0] = r / intensity;
-            colorVal[1] = g / intensity;
-            colorVal[2] = b / intensity;
+            lightColours[i] = { r / intensity, g / intensity, b / intensity };
         }
         else
         {
-            colorVal[0] = colorVal[1] = colorVal[2] = 0.0f;
+            lightColours[i] = { 0.0f, 0.0f, 0.0f };
             intensity = 0.0f;
         }
+        // making the lights default a little brighter
+        lightIntensities[i] = intensity * 15.0f;
+    }
 
+    // send light uniforms
+    for (auto i{ 0u }; i < MAX_LIGHTS; ++i)
+    {
         if (lightingPosLocs[i] != -1) glUniform3fv(lightingPosLocs[i], 1, &LightingPositions[i].x);
-        if (lightingColorLocs[i] != -1) glUniform3fv(lightingColorLocs[i], 1, colorVal);
+        if (lightingColorLocs[i] != -1) glUniform3fv(lightingColorLocs[i], 1, &lightColours[i].x);
 
         const f32 constant = 1.0f;
         const f32 linear = 0.7f;
@@ -464,9 +589,7 @@ void lightingPass()
         if (lightingLinearsLocs[i] != -1) glUniform1f(lightingLinearsLocs[i], linear);
         if (lightingQuadraticsLocs[i] != -1) glUniform1f(lightingQuadraticsLocs[i], quadratic);
 
-        // making the lights default a little brighter
-        intensity *= 15.0f;
-        if (lightingIntensityLocs[i] != -1) glUniform1f(lightingIntensityLocs[i], intensity);
+        if (lightingIntensityLocs[i] != -1) glUniform1f(lightingIntensityLocs[i], lightIntensities[i]);
         if (lightingRadiiLocs[i] != -1) glUniform1f(lightingRadiiLocs[i], LightingRadii[i]);
     }
 
@@ -539,6 +662,8 @@ void lightingPass()
 }
 void render(f32 dt)
 {
+    frameBegin();
+
     f32 t = (f32)SDL_GetTicks() / 1000.0f;
     updateCoreShaderUBO(t, &camera.pos);
     renderSkybox();     
@@ -624,11 +749,16 @@ void render(f32 dt)
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
     glFrontFace(GL_CCW);
+
+    frameEnd();
 }
 
 void destroy()
 {
     INFO("Cleaning up...");
+    jobSystemShutdown();
+    logFrameArenaStats();
+    frameArenasDestroy();
     // Destroy framebuffers
     destroyFramebuffer(&mainFBO);
     destroyFramebuffer(&skyboxFBO);
@@ -646,6 +776,17 @@ void destroy()
         freeMesh(skyboxMesh);
         skyboxMesh = nullptr;
     }
+    sidMapDestroy(&shaderSids);
+    sidMapDestroy(&modelSids);
+    sidMapDestroy(&textureSids);
+    resourceIndexClose(&resourceIndex);
+    sidReverseTableDestroy();
+    stringPoolShutdown();
+    releaseResourceMemory();
+    memTrackLog();
+#if MEM_TRACK_DETAILED
+    memTrackDumpJson("memory_report.json");
+#endif
     INFO("Cleanup complete!");
 }
 
@@ -724,6 +865,10 @@ static void handleCameraInput(f32 dt)
 
 int main(int argc, char** argv)
 {
+    // offline step: GraphicsUniWork --bake-resource-index <resDir> <outFile>
+    if (argc >= 4 && strcmp(argv[1], "--bake-resource-index") == 0)
+        return bakeResourceIndex(argv[2], argv[3]) ? 0 : -1;
+
     app = createApplication(init, update, render, destroy);
 
     if (!app)